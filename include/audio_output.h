@@ -0,0 +1,56 @@
+/*
+audio_output.h: header file for audio_output.cpp
+
+The AudioOutput owns the SDL audio device the APU's samples are played on (16-bit stereo). The GameBoy writes the
+samples of every frame into an AudioRing, which the device's callback drains from SDL's audio thread; if the ring runs
+dry the callback holds the last sample (and counts an underrun) rather than letting the output jump to silence.
+
+The GameBoy aims to keep latency seconds of audio buffered. Frames paced by the wall clock (or by a display refreshing at
+60 Hz instead of 59.7275 Hz) drift against the sound card's clock, so after every frame rate_adjustment() gives the
+factor to stretch the next frame's samples by: the steady drift between the clocks (learned over a few seconds, up to
+1%), plus up to max_rate_deviation (0.5%, too little to hear as a change of pitch) more while the ring is below the
+target, less while it is above. Playback starts once the ring first reaches the target. Alternatively the sound card can
+pace the emulation (GameBoy::set_audio_sync): the next frame then starts whenever the ring drops below the target.
+*/
+
+#ifndef AUDIO_OUTPUT_H
+#define AUDIO_OUTPUT_H
+
+#include <SDL2/SDL.h>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include "audio_ring.h"
+
+class AudioOutput {
+    public:
+        AudioOutput(int sample_rate);
+        ~AudioOutput();
+
+        bool opened() { return device_ != 0; }; // false if there is no audio device, the samples are then discarded
+        int sample_rate() { return sample_rate_; }; // what the device was opened with, which may differ from the one asked for
+        void set_latency(double seconds); // how much audio to keep buffered, clamped to 10 - 200 ms (30 ms by default)
+        void queue(const int16_t* samples, size_t count); // count interleaved stereo samples
+        double rate_adjustment(); // the factor to produce the next samples at, to bring the ring back to the target
+        bool wants_samples() { return ring_.size() < target_; }; // the ring is below the target
+        uint64_t underruns() { return underruns_.load(std::memory_order_relaxed); }; // callbacks the ring ran dry in
+
+        static constexpr double max_rate_deviation = 0.005;
+        static constexpr double max_drift = 0.01;
+    private:
+        static void callback_(void* userdata, Uint8* stream, int length);
+
+        SDL_AudioDeviceID device_ = 0;
+        int sample_rate_;
+        AudioRing ring_ {16384}; // room for more than the longest latency
+        double latency_ = 0.03;
+        size_t target_ = 0; // samples to keep in the ring
+        bool started_ = false; // the device is playing
+        double drift_ = 0; // how much faster the sound card's clock runs than the frames, as learned so far
+        static constexpr double drift_rate = 0.00003; // of the error, per frame
+        std::atomic<uint64_t> underruns_ {0};
+        std::array<int16_t, 2> last_ {}; // the last sample played, used only by the callback
+};
+
+#endif
@@ -0,0 +1,33 @@
+/*
+audio_ring.h: header file for audio_ring.cpp
+
+A lock-free single producer / single consumer ring of stereo samples: the emulation thread writes the samples of every
+frame, the SDL audio callback reads them. Each side only writes its own index (with release ordering, after the
+samples are copied) and reads the other's (with acquire ordering), so neither ever waits for the other.
+*/
+
+#ifndef AUDIO_RING_H
+#define AUDIO_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class AudioRing {
+    public:
+        AudioRing(size_t capacity); // in stereo samples, rounded up to a power of two
+        size_t write(const int16_t* samples, size_t count); // producer: returns how many fitted
+        size_t read(int16_t* samples, size_t count); // consumer: returns how many there were
+        size_t size(); // samples buffered, as seen by the producer
+        size_t capacity() { return mask_ + 1; };
+
+    private:
+        std::vector<int16_t> buffer_; // interleaved left / right
+        size_t mask_;
+        // on separate cache lines, so the two threads do not keep taking the line from each other
+        alignas(64) std::atomic<size_t> write_index_ {0};
+        alignas(64) std::atomic<size_t> read_index_ {0};
+};
+
+#endif
@@ -8,8 +8,9 @@
 class BootROM {
     public:
         BootROM();
-        void load_bootrom_file(std::string bootrom_file);
+        void load_bootrom_file(std::string bootrom_file); // throws std::runtime_error if the file cannot be opened
         uint8_t read(uint16_t address); // when the bus needs to read data from the bootrom
+        const uint8_t* data() { return bootrom_.data(); }; // the 256 bytes, for OAM DMA
 
         void write_bank(uint8_t value);
         uint8_t read_bank();
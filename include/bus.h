@@ -15,19 +15,52 @@ Constructor: take pointers to hardware components created in the Gameboy class,
 #include "bootrom.h"
 #include "cartridge.h"
 #include "cpu.h"
+#include "interrupts.h"
 #include "joypad.h"
 #include "ram.h"
 #include "ppu.h"
 #include "serial.h"
+#include "sound.h"
 #include "timers.h"
+#ifdef GB_STATS
+#include "stats.h"
+#endif
 
+class Timeline;
 
 class Bus {
     public:
-        Bus(CPU* cpu, RAM* ram, PPU* ppu, BootROM* bootrom, Cartridge* cartridge, Serial* serial, Timers* timers, Joypad* joypad);
+        Bus(CPU* cpu, RAM* ram, PPU* ppu, BootROM* bootrom, Cartridge* cartridge, Serial* serial, Timers* timers, Joypad* joypad, Sound* sound, InterruptController* interrupts);
         void write(uint16_t address, uint8_t value);
         uint8_t read(uint16_t address);
+        uint8_t peek(uint16_t address); // read without side effects (I/O registers read as 0xff), for debugging tools
+        uint16_t rom_bank() { return cartridge_->rom_bank(); }; // the bank mapped at 0x4000 - 0x7fff
+        uint64_t cycle_count() { return cpu_->cycle_count(); }; // for the components scheduling work against the CPU's clock
+        const uint8_t* dma_source(uint8_t page); // the memory at page * 0x100, if it can be read directly (nullptr otherwise)
+
+        // hardware events are recorded to the timeline while one is set (see timeline.h)
+        void set_timeline(Timeline* timeline) { timeline_ = timeline; };
+        Timeline* timeline() { return timeline_; };
+#ifdef GB_STATS
+        Stats& stats() { return stats_; }; // execution statistics (see stats.h)
+#endif
     private:
+#ifdef GB_STATS
+        Stats stats_;
+#endif
+        void record_write_(uint16_t address, uint8_t value); // record the events a write causes on the timeline
+
+        // the memory map. While an OAM DMA transfer is scheduled it is swapped for one that cuts the CPU off (see
+        // dma_blocks_), so the accesses outside of a transfer never look at it
+        uint8_t read_mapped_(uint16_t address); // read from whatever is mapped at the address
+        void write_mapped_(uint16_t address, uint8_t value);
+        uint8_t read_during_dma_(uint16_t address);
+        void write_during_dma_(uint16_t address, uint8_t value);
+        bool dma_blocks_(uint16_t address); // the transfer has the bus (or has just ended, and the normal map is back)
+        uint8_t (Bus::*read_)(uint16_t) = &Bus::read_mapped_;
+        void (Bus::*write_)(uint16_t, uint8_t) = &Bus::write_mapped_;
+        Timeline* timeline_ = nullptr;
+
         CPU* cpu_; 
         RAM* ram_;
         PPU* ppu_;
@@ -36,6 +69,8 @@ class Bus {
         Serial* serial_;
         Timers* timers_;
         Joypad* joypad_;
+        Sound* sound_;
+        InterruptController* interrupts_;
 };
 
 
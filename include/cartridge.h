@@ -12,9 +12,15 @@
 
 class Cartridge {
     public:
-        void load_cartridge_from_file(std::string cartridge_file);
+        // persistent_saves: keep the RAM of battery-backed cartridges in a .sav file next to the ROM. Throws
+        // std::runtime_error if the file cannot be opened, or is not a cartridge this emulator supports
+        void load_cartridge_from_file(std::string cartridge_file, bool persistent_saves = true);
+        void print_info(); // print the cartridge type and ROM / RAM sizes read from the header
         uint8_t read(uint16_t address);
         void write(uint16_t address, uint8_t value); // if this cartridge has an MBC, we need to access the external RAM + MBC registers
+        void set_rtc_clock(CPU* cpu) { if (mbc_) mbc_->set_rtc_clock(cpu); }; // time source of the real-time clock (see mbc3.h)
+        uint16_t rom_bank() { return mbc_ ? mbc_->rom_bank() : 1; }; // ROM bank mapped to 0x4000 - 0x7fff (for debugging tools)
+        const uint8_t* dma_source(uint8_t page); // the ROM or RAM at page * 0x100 as the CPU sees it, nullptr if it is not memory
     private:
         std::vector<uint8_t> cartridge_; // store the contents of the cartridge into a vector - since this might be variable length with different MBCs, this may be different sizes
         uint8_t mbc_header_val_; // MBC (memory bank controller) mode of the cartridge
@@ -26,6 +32,8 @@ class Cartridge {
             {0x1, "MBC1"},
             {0x2, "MBC1 + RAM"},
             {0x3, "MBC1 + RAM + BATTERY"},
+            {0x0f, "MBC3 + TIMER + BATTERY"},
+            {0x10, "MBC3 + TIMER + RAM + BATTERY"},
             {0x11, "MBC3"},
             {0x12, "MBC3 + RAM"},
             {0x13, "MBC3 + RAM + BATTERY"}
@@ -2,12 +2,15 @@
 #define CPU_H
 
 #include <array>
-#include <fstream>
 #include <vector>
 #include <cstdint>
+#include "idle_loop.h"
+#include "interrupts.h"
 
 
 class Bus; // forward declaration
+class Tracer;
+class Profiler;
 
 class CPU {
     public:
@@ -15,20 +18,47 @@ class CPU {
         ~CPU();
         void cycle();
         void connect_bus(Bus* bus);
+        void connect_interrupts(InterruptController* interrupts);
 
-        // read/write registers + hram 
-        uint8_t read_ie();
-        void write_ie(uint8_t value);
-        uint8_t read_if();
-        void write_if(uint8_t value); // make requests for interrupts 
+        // read/write hram 
         uint8_t read_hram(uint16_t address);
         void write_hram(uint16_t address, uint8_t value);
 
+        // register state, for test harnesses and debugging tools
+        struct Registers {
+            uint16_t af; uint16_t bc; uint16_t de; uint16_t hl;
+            uint16_t sp; uint16_t pc;
+        };
+        Registers get_registers();
+        void skip_bootrom(); // start with the register values left behind by the DMG boot ROM, at the cartridge entry point 0x100
+        bool breakpoint_hit() { return breakpoint_hit_; }; // LD B,B was executed (used by mooneye test ROMs to signal completion)
+        uint64_t cycle_count() { return t_cycles_elapsed_; }; // t-cycles since power on
+        uint64_t instruction_count() { return instructions_elapsed_; }; // instructions executed since power on
+        bool waiting() { return halt_mode || idle_loop_.repeated(); }; // halted, or the start of a busy-wait loop was just fetched: check halted() / idle_loop_cycles()
+        bool halted() { return halt_mode && !interrupts_->pending(); }; // waiting in HALT for an interrupt, cycle() only counts cycles
+        void skip_halted(uint32_t cycles); // let cycles pass in HALT at once, as that many calls to cycle() would
+        void set_idle_loop_overrides(std::vector<IdleLoop::Override> overrides) { idle_loop_.set_overrides(std::move(overrides)); };
+        uint32_t idle_loop_cycles() { return idle_loop_.repeated() ? check_idle_loop_() : 0; }; // after a cycle: the length of the busy-wait loop just restarted, if it can be skipped (see idle_loop.h)
+        void skip_idle_loop(uint32_t iterations); // let iterations of that loop pass at once
+#ifdef GB_TRACE
+        void attach_tracer(Tracer* tracer) { tracer_ = tracer; }; // record every executed instruction (nullptr to stop)
+#endif
+#ifdef GB_PROFILE
+        void attach_profiler(Profiler* profiler) { profiler_ = profiler; }; // report instruction fetches and interrupt dispatch (nullptr to stop)
+#endif
+
     private:
-        // GIVE STARTING VALUES FOR CPU-DEBUG
-        bool log = false;
-        std::ofstream log_file {"cpu_log.txt"};
-        void cpu_log_(); // log the current state of the cpu registers
+#ifdef GB_TRACE
+        Tracer* tracer_ = nullptr;
+        void trace_(); // hand the state at the start of the next instruction to the tracer
+#endif
+#ifdef GB_PROFILE
+        Profiler* profiler_ = nullptr;
+#endif
+        IdleLoop idle_loop_;
+        uint32_t check_idle_loop_();
+        uint64_t t_cycles_elapsed_ = 0;
+        uint64_t instructions_elapsed_ = 0;
         // 16 bit registers
         uint16_t pc_ = 0x0; // program counter
         uint16_t sp_ = 0x0; // stack pointer
@@ -37,12 +67,12 @@ class CPU {
 
         // 8 bit registers
         uint8_t ir_ = 0; // instruction register
-        uint8_t ie_ = 0; // interrupt enable
 
         std::array<uint8_t, 126> hram_; // high ram, quickly accessible ram
 
         bool halt_mode = false; // indicate whether or not the CPU is halted by the HALT instruction
         bool stop_mode = false; // indicate whether the STOP instruction was called
+        bool breakpoint_hit_ = false; // set by the LD B,B "software breakpoint"
 
         Bus* bus_; // create a reference to the bus connecting all the hardware components together
         uint8_t read(uint16_t address);
@@ -61,8 +91,6 @@ class CPU {
         void set_flag(flags flag, bool val);
         uint8_t read_flag(flags flag);
 
-        bool ime_ = 0; // interrupt master enable flag (write only). Starts disabled when game begins
-        uint8_t if_ = 0; // interrupt flag
 
         // --- INSTRUCTION IMPLEMENTATION HELPERS ---
         void INC_DEC_8BIT(uint16_t* reg, bool upper, bool inc); // helper function for all of the 8 bit register inc / dec operations on registers within 16 bit register combos
@@ -107,16 +135,9 @@ class CPU {
         uint8_t t_cycles_delay = 0; // the number of system clock ticks that an instruction requires to complete
 
         // -- INTERRUPT HANDLING -- 
-        enum interrupts {
-            VBlank = (1 << 0),
-            LCD = (1 << 1),
-            Timer = (1 << 2),
-            Serial = (1 << 3),
-            Joypad = (1 << 4)
-        };
-
-        void handle_interrupts(); // handle all pending interrupts, interrupt service routine (transferring to interrupt handler) takes 20 t-cycles
-        void call_handler(interrupts interrupt, uint8_t handler_location); // call the respective handler for interrupt
+        InterruptController* interrupts_; // IF, IE and IME (see interrupts.h)
+        void handle_interrupts(); // handle the highest priority pending interrupt, interrupt service routine (transferring to interrupt handler) takes 20 t-cycles
+        void call_handler(int interrupt); // call the handler for the interrupt (its bit in IF)
         bool ei_delay = false; // the effect of the instruction EI needs to be delayed by 1 instruction. This flag indicates that the EI instruction was just called, and to not handle interrupts until one instruction later
         bool halt_bug = false; // emulate the behaviour of the halt bug, which occurs when halt is called and IME == 0, while ie & if != 0
 
@@ -0,0 +1,37 @@
+/*
+display.h: header file for display.cpp
+
+The Display owns the SDL window, renderer and texture. The PPU only produces an indexed framebuffer
+(one shade 0-3 per pixel), so the emulation core can run without a window (headless); the Display
+converts the shades to colours and presents the finished frame.
+*/
+
+#ifndef DISPLAY_H
+#define DISPLAY_H
+
+#include <SDL_render.h>
+#include <SDL_video.h>
+#include <array>
+#include <cstdint>
+#include <string>
+
+#include "ppu.h"
+
+class Display {
+    public:
+        Display();
+        ~Display();
+
+        void render(const std::array<uint8_t, SCREEN_WIDTH * SCREEN_HEIGHT>& framebuffer); // upload the framebuffer to the texture and draw it to the back buffer
+        void present(); // show the back buffer in the window
+        void set_title(const std::string& title);
+
+    private:
+        SDL_Window* window_;
+        SDL_Renderer* renderer_;
+        SDL_Texture* texture_;
+
+        std::array<uint32_t, SCREEN_WIDTH * SCREEN_HEIGHT> pixels_; // RGBA8888 staging buffer for the texture upload
+};
+
+#endif
@@ -0,0 +1,45 @@
+/*
+frame_exchange.h: header file for frame_exchange.cpp
+
+A lock-free triple buffer of frames between the emulation thread (producer) and the presentation thread (consumer).
+The producer fills its back frame and publishes it by swapping it with the middle one; the consumer takes the middle
+one by swapping it with its front frame, if it is newer than the one it has. The only shared state is the index of
+the middle frame (and whether it is new) in one atomic, so neither side ever waits for the other: the emulator
+publishes at its own pace (a frame the display had no time for is replaced by the next), and the display always
+gets the newest frame. Each frame travels with its hash, so the consumer can tell a frame identical to the last one it
+showed without comparing the pixels.
+*/
+
+#ifndef FRAME_EXCHANGE_H
+#define FRAME_EXCHANGE_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+#include "raster.h"
+
+class FrameExchange {
+    public:
+        using Frame = std::array<uint8_t, SCREEN_WIDTH * SCREEN_HEIGHT>;
+
+        // producer
+        Frame& back() { return frames_[back_]; }; // the frame to fill
+        void publish(uint64_t hash); // hand the back frame (whose hash is given) over, and get another one to fill
+
+        // consumer
+        bool fresh() { return middle_.load(std::memory_order_relaxed) & fresh_bit; }; // a frame was published since the last take()
+        const Frame& take(); // the newest published frame (which stays valid until the next take())
+        uint64_t taken_hash() { return hashes_[front_]; }; // the hash of the frame take() returned
+
+    private:
+        static constexpr uint8_t fresh_bit = 4;
+
+        std::array<Frame, 3> frames_ {};
+        std::array<uint64_t, 3> hashes_ {}; // of each frame, written along with it
+        uint8_t back_ = 0; // only used by the producer
+        uint8_t front_ = 2; // only used by the consumer
+        alignas(64) std::atomic<uint8_t> middle_ {1}; // index of the middle frame, with fresh_bit if it was published
+};
+
+#endif
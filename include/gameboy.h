@@ -1,30 +1,97 @@
 #ifndef GAMEBOY_H
 #define GAMEBOY_H
 
+#include "audio_output.h"
 #include "bootrom.h"
 #include "cartridge.h"
 #include "cpu.h"
+#include "display.h"
+#include "frame_exchange.h"
+#include "instrumentation.h"
+#include "timeline.h"
 #include "joypad.h"
+#include "perf_counters.h"
 #include "ppu.h"
 #include "ram.h"
 #include "serial.h"
 #include "sound.h"
 #include "bus.h"
 #include "timers.h"
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#ifdef GB_TRACE
+#include "tracer.h"
+#endif
+#ifdef GB_PROFILE
+#include "profiler.h"
+#endif
 
 class GameBoy {
     public:
-        GameBoy(std::string bootrom_file, std::string cartridge_file);
-        void run();
+        // an empty bootrom_file skips the boot ROM and starts the cartridge directly. A headless GameBoy has no window,
+        // and is driven one frame at a time through run_frame() (e.g. by the test ROM harness)
+        GameBoy(std::string bootrom_file, std::string cartridge_file, bool headless = false);
+        void run(); // emulate on a thread of its own, and present the frames on this one until the window is closed
+        void run_frame(); // emulate one frame's worth of master clock cycles (70224), without presenting or pacing
         ~GameBoy();
+
+        // access to the hardware state, for tools driving a headless GameBoy
+        CPU& cpu() { return cpu_; };
+        PPU& ppu() { return ppu_; };
+        Serial& serial() { return serial_; };
+        Sound& sound() { return sound_; }; // the samples of the frames run so far, once a sample rate is set
+        const Instrumentation& instrumentation() { return instrumentation_; }; // host time per frame, by emulator section
+        void set_stats_interval(double seconds); // print the frame timing report every few seconds (0 to stop)
+        void set_audio_latency(double seconds); // how much sound to keep buffered ahead of the audio device (see audio_output.h)
+        void set_audio_sync(bool sync); // pace the frames by the audio device's clock instead of the wall clock
+        // pin the emulation thread to a CPU (unless cpu < 0), and / or run it with SCHED_FIFO (Linux only, from the next run())
+        void set_emulation_thread(int cpu, bool realtime);
+        void set_rtc_clock(bool emulated); // run the cartridge's real-time clock on emulated time instead of the host's clock
+        void start_timeline(std::string timeline_file); // record host frame phases and hardware events (see timeline.h)
+        PerfCounters& start_perf_counters(); // count hardware events per frame and subsystem (see perf_counters.h)
+        PerfCounters* perf_counters() { return perf_counters_.get(); }; // nullptr if not started
+        uint64_t frame_hash(); // 64-bit hash of the last completed frame
+        // draw the frames from now on, or only emulate them (see PPU::set_rendering). A tool that looks at some frames only
+        // (fast-forwarding, a bot reading every 4th frame) turns it on for those, and checks frame_rendered() after run_frame()
+        void set_rendering(bool render);
+        bool frame_rendered(); // the frame completed by the last run_frame() was drawn
+        // run(): draw one frame in frames + 1, or (-1, the default) skip drawing up to max_auto_skip frames in a row while
+        // the emulation is behind the frame pacing, to keep it at full speed on an overloaded host
+        void set_frame_skip(int frames);
+        static constexpr int max_auto_skip = 3;
+        void set_input(uint8_t buttons); // press the buttons set in the mask (see Joypad::set_state), e.g. when replaying a movie
+#ifdef GB_TRACE
+        void start_trace(std::string trace_file); // record every executed instruction to a binary trace file (see tracer.h)
+#endif
+#ifdef GB_PROFILE
+        Profiler& start_profile(bool exact, uint32_t sample_period); // profile the guest code from now on (see profiler.h)
+#endif
     private:
-        void poll_events();
+        void emulate_(); // the emulation thread of run()
+        void configure_emulation_thread_();
+        void poll_events(); // on the presentation thread
+        uint32_t skip_waiting_(unsigned int master_clock_cycle); // skip the cycles a halted CPU or an idle loop would only wait
     private:
         // state
-        bool running_ = true; // start the system as automatically running
+        std::atomic<bool> running_ {true}; // start the system as automatically running
+        bool headless_ = false;
+
+        Instrumentation instrumentation_; // only used by the emulation thread
+        std::atomic<bool> show_stats_ {false}; // frame timing readout in the window title, toggled with F1
+        double stats_interval_ = 0; // seconds between frame timing reports, 0 for none
+        bool audio_sync_ = false;
+        int frame_skip_ = -1;
 
        // hardware components
        
+        InterruptController interrupts_; // IF / IE / IME, which the CPU, PPU and timers are wired to
         RAM ram_;        
         PPU ppu_;
         Sound sound_;
@@ -34,7 +101,55 @@ class GameBoy {
         Serial serial_;
         Timers timers_;
         Joypad joypad_;
-        Bus bus_ {&cpu_, &ram_, &ppu_, &bootrom_, &cartridge_, &serial_, &timers_, &joypad_}; 
+        Bus bus_ {&cpu_, &ram_, &ppu_, &bootrom_, &cartridge_, &serial_, &timers_, &joypad_, &sound_, &interrupts_};
+
+        std::unique_ptr<Display> display_; // window the frames are presented to, nullptr when headless
+        std::unique_ptr<AudioOutput> audio_; // audio device the samples are played on, nullptr when headless
+        std::vector<int16_t> samples_; // a frame's samples on their way from the APU to the audio device
+
+        // between the emulation thread and the presentation thread (run())
+        FrameExchange frames_; // completed frames
+        std::atomic<uint8_t> input_ {0}; // the buttons held (see Joypad::set_state)
+        std::atomic<uint64_t> input_time_ {0}; // Instrumentation ticks spent polling input since the emulation thread last looked
+        std::atomic<uint64_t> present_time_ {0}; // and presenting
+        std::mutex title_mutex_;
+        // only used by the presentation thread
+        bool window_visible_ = true; // not minimized or hidden
+        bool repaint_ = false; // present the next frame even if it is the one on screen
+        uint64_t presented_hash_ = 0;
+        std::string title_; // for the window, set by the emulation thread when the frame timing readout is on
+        int emulation_cpu_ = -1;
+        bool realtime_ = false;
+        std::unique_ptr<Timeline> timeline_;
+        std::unique_ptr<PerfCounters> perf_counters_;
+        PerfCounters* frame_counters_ = nullptr; // the emulating thread's: perf_counters_, or the emulation thread's own in run()
+        uint64_t perf_instructions_start_ = 0;
+#ifdef GB_TRACE
+        std::unique_ptr<Tracer> tracer_;
+#endif
+#ifdef GB_PROFILE
+        std::unique_ptr<Profiler> profiler_;
+#endif
+#ifdef GB_STATS
+        std::string stats_file_; // <rom name>.stats.txt, written when the GameBoy is destroyed
+#endif
 };
 
+// for the programs loading the files given on their command line: what load() returns, or if one of them could not be
+// loaded (load() threw std::runtime_error, see Cartridge::load_cartridge_from_file), the error printed and exit(-1)
+template <typename Load>
+auto load_or_exit(Load load)
+{
+    try {
+        return load();
+    }
+    catch (const std::runtime_error& e) {
+        std::cout << "Error: " << e.what() << std::endl;
+        exit(-1);
+    }
+}
+
+// a GameBoy running the cartridge (see GameBoy::GameBoy), or exit(-1) if it or the boot ROM could not be loaded
+std::unique_ptr<GameBoy> load_or_exit(std::string bootrom_file, std::string cartridge_file, bool headless = false);
+
 #endif
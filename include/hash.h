@@ -0,0 +1,86 @@
+/*
+hash.h: fast 64-bit hashing of emulator output (framebuffers, audio blocks)
+
+Implements XXH64 (seed 0), so a hash printed by the emulator can be checked against any other
+xxHash implementation (e.g. `xxhsum -H1`) run over the same bytes.
+*/
+
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace hash {
+    constexpr uint64_t prime1 = 0x9e3779b185ebca87ULL;
+    constexpr uint64_t prime2 = 0xc2b2ae3d27d4eb4fULL;
+    constexpr uint64_t prime3 = 0x165667b19e3779f9ULL;
+    constexpr uint64_t prime4 = 0x85ebca77c2b2ae63ULL;
+    constexpr uint64_t prime5 = 0x27d4eb2f165667c5ULL;
+
+    inline uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); };
+    inline uint64_t read64(const uint8_t* p) { uint64_t v; std::memcpy(&v, p, 8); return v; }; // little endian hosts only
+    inline uint32_t read32(const uint8_t* p) { uint32_t v; std::memcpy(&v, p, 4); return v; };
+    inline uint64_t round(uint64_t acc, uint64_t input) { return rotl(acc + input * prime2, 31) * prime1; };
+    inline uint64_t merge(uint64_t acc, uint64_t val) { return (acc ^ round(0, val)) * prime1 + prime4; };
+
+    inline uint64_t xxh64(const void* data, size_t length)
+    {
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        const uint8_t* end = p + length;
+        uint64_t h;
+
+        if (length >= 32) {
+            // four independent lanes of 8 bytes each, so the multiplies can overlap
+            uint64_t v1 = prime1 + prime2;
+            uint64_t v2 = prime2;
+            uint64_t v3 = 0;
+            uint64_t v4 = 0 - prime1;
+            const uint8_t* limit = end - 32;
+            do {
+                v1 = round(v1, read64(p));
+                v2 = round(v2, read64(p + 8));
+                v3 = round(v3, read64(p + 16));
+                v4 = round(v4, read64(p + 24));
+                p += 32;
+            } while (p <= limit);
+
+            h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+            h = merge(h, v1);
+            h = merge(h, v2);
+            h = merge(h, v3);
+            h = merge(h, v4);
+        }
+        else {
+            h = prime5;
+        }
+
+        h += length;
+
+        // consume the remaining (less than 32) bytes
+        for (; p + 8 <= end; p += 8) {
+            h ^= round(0, read64(p));
+            h = rotl(h, 27) * prime1 + prime4;
+        }
+        if (p + 4 <= end) {
+            h ^= static_cast<uint64_t>(read32(p)) * prime1;
+            h = rotl(h, 23) * prime2 + prime3;
+            p += 4;
+        }
+        for (; p < end; p++) {
+            h ^= (*p) * prime5;
+            h = rotl(h, 11) * prime1;
+        }
+
+        // final avalanche
+        h ^= h >> 33;
+        h *= prime2;
+        h ^= h >> 29;
+        h *= prime3;
+        h ^= h >> 32;
+        return h;
+    }
+}
+
+#endif
@@ -0,0 +1,92 @@
+/*
+idle_loop.h: header file for idle_loop.cpp
+
+Detects the busy-wait loops many games spin in instead of HALTing, e.g.
+    wait: ldh a, (0x44)  ; LY
+          cp 0x90
+          jr nz, wait
+A short loop (closed by a backward jump of up to max_length bytes) repeats exactly when an iteration writes nothing,
+takes no interrupt and ends with the registers it started with, and nothing it could have read changed while it ran:
+every following iteration then does the same, until the hardware next changes state. Within a frame that only happens
+at a PPU mode change, a TIMA increment or a change of DIV, so the GameBoy checks that none of those happened during the
+last iteration (PPU::quiet_cycles, Timers::quiet_cycles) and lets whole iterations pass at once up to the next one.
+Nothing is recorded per memory read, so loops doing real work cost no more than a compare per backward jump.
+
+Loops the heuristic misses (longer ones, or ones storing a flag on every iteration) can be listed per ROM in the
+override table in idle_loop.cpp, keyed by the header checksums: these are tracked up to the given length, and may
+write WRAM / HRAM as long as the value written is already there. They are still only skipped when an iteration repeats
+exactly, so a wrong entry costs time, never correctness.
+*/
+
+#ifndef IDLE_LOOP_H
+#define IDLE_LOOP_H
+
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+class Bus;
+
+class IdleLoop {
+    public:
+        struct Override {
+            uint8_t header_checksum; // 0x14d
+            uint16_t global_checksum; // 0x14e - 0x14f
+            uint16_t address; // the start of the loop (where its backward jump goes)
+            uint16_t length; // bytes from the start of the loop to its backward jump
+        };
+        static std::vector<Override> overrides_for(uint8_t header_checksum, uint16_t global_checksum); // entries for one ROM
+        void set_overrides(std::vector<Override> overrides) { overrides_ = std::move(overrides); };
+
+        static const uint16_t max_length = 16; // longest loop body the heuristic considers
+        using Registers = std::array<uint16_t, 6>; // af, bc, de, hl, sp, ime
+
+        // called by the CPU
+        bool tracking() { return tracking_; };
+        bool at_start(uint16_t pc) { return pc == start_; };
+        // a jump went backwards from -> to: to may be the start of a loop
+        void branch(uint16_t from, uint16_t to)
+        {
+            if (to == start_) {
+                closed_by_ = from;
+            }
+            else if (to != rejected_ || from != rejected_by_) {
+                new_loop_(from, to);
+            }
+        };
+        void iteration(const Registers& registers, uint64_t cycle, uint64_t instructions); // the start of the loop is being fetched
+        void write(uint16_t address, uint8_t value, Bus* bus);
+        void not_idle() { idle_ = false; }; // an interrupt was taken, or EI / RETI / HALT / STOP executed
+
+        // the length in cycles of the loop if the iteration that just ended repeated the one before. Only valid right after the
+        // start of the loop was fetched, 0 otherwise
+        bool repeated() { return repeated_; };
+        uint32_t repeating_cycles();
+        uint32_t cycles() { return cycles_; };
+        uint64_t skip(uint32_t iterations); // iterations were skipped, returns the number of instructions they would have executed
+
+    private:
+        void new_loop_(uint16_t from, uint16_t to);
+        static const int max_misses = 2; // iterations in a row that differ from the one before, before a loop is given up on
+
+        std::vector<Override> overrides_;
+        uint32_t start_ = UINT32_MAX; // address of the loop being tracked
+        uint16_t closed_by_ = 0; // the jump that ended the last iteration
+        // a loop given up on (e.g. counting), not tracked again while it is entered through the same jump
+        uint32_t rejected_ = UINT32_MAX;
+        uint16_t rejected_by_ = 0;
+        int misses_ = 0;
+        bool writes_allowed_ = false; // the loop has an override entry
+        bool tracking_ = false; // an iteration is being watched
+        bool idle_ = false; // nothing has been seen yet in this iteration that could make the next one differ
+        bool repeated_ = false; // the last iteration matched the one before
+
+        Registers registers_ {};
+        uint64_t start_cycle_ = 0;
+        uint64_t start_instructions_ = 0;
+        uint32_t cycles_ = 0; // length of the last iteration
+        uint64_t instructions_ = 0;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,83 @@
+/*
+instrumentation.h: header file for instrumentation.cpp
+
+Measures how much host time every frame spends in each part of the emulator: the CPU, PPU and timers (emulation),
+polling input, presenting the frame (texture upload + present), and waiting for the frame length to be up (pacing).
+The time of the last `history` frames is kept per section, so the mean, p50, p99 and max can be queried at any time.
+
+Timing every master clock cycle would cost more than the work being measured, so only every sample_stride'th cycle
+times the CPU, PPU and timers separately. The whole emulation loop is timed as one, and split between the three in
+the proportions of the samples. The clock is the TSC where there is one (calibrated against steady_clock), and
+steady_clock otherwise.
+*/
+
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+class Instrumentation {
+    public:
+        enum Section { CPU, PPU, Timers, Input, Present, Pacing, Frame, section_count };
+        static constexpr const char* section_names[section_count] = {"cpu", "ppu", "timers", "input", "present", "pacing", "frame"};
+
+        static constexpr unsigned int sample_stride = 256; // master clock cycles per sampled cycle
+        static constexpr size_t history = 600; // frames (10 seconds)
+
+        struct Stats {
+            double mean_us = 0;
+            double p50_us = 0;
+            double p99_us = 0;
+            double max_us = 0;
+        };
+
+        Instrumentation();
+
+        static uint64_t now()
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            return __rdtsc();
+#else
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+        };
+
+        void add(Section section, uint64_t ticks) { current_[section] += ticks; }; // time spent in a section this frame
+        void add_emulation_sample(uint64_t cpu, uint64_t ppu, uint64_t timers)
+        {
+            samples_[CPU] += cpu;
+            samples_[PPU] += ppu;
+            samples_[Timers] += timers;
+        };
+        void end_emulation(uint64_t ticks); // time of the whole emulation loop, split between CPU, PPU and timers
+        void end_frame(); // the frame is over: move its times into the history
+
+        // queries
+        Stats stats(Section section) const; // over the frames in the history
+        uint64_t frames() const { return frames_; };
+        double fps() const; // frames per second of host time, over the history
+        std::string summary() const; // short one line readout (e.g. for the window title)
+        void write_report(std::ostream& out) const; // table of every section
+
+    private:
+        double ticks_per_us_ = 1000.0; // refined against steady_clock as frames go by
+        uint64_t start_ticks_;
+        std::chrono::steady_clock::time_point start_time_;
+
+        std::array<uint64_t, section_count> current_ {};
+        std::array<uint64_t, section_count> samples_ {};
+        uint64_t last_frame_end_ = 0;
+
+        std::array<std::array<uint64_t, history>, section_count> history_ {}; // ring of per-frame times, in ticks
+        uint64_t frames_ = 0;
+};
+
+#endif
\ No newline at end of file
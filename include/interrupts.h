@@ -0,0 +1,57 @@
+/*
+interrupts.h: header file for interrupts.cpp
+
+The interrupt controller: IF (0xff0f), IE (0xffff) and the CPU's interrupt master enable (IME). The PPU and the timers
+request interrupts by calling request() directly, instead of reading and writing IF through the bus.
+
+The interrupts that are both requested and enabled are kept as a mask, recomputed only when IF, IE or IME change: the
+CPU wakes from HALT while pending() is non-zero, and dispatches while ready() is. The highest priority interrupt is the
+lowest set bit (VBlank first, Joypad last), and its handler is at 0x40 + 8 * bit.
+*/
+
+#ifndef INTERRUPTS_H
+#define INTERRUPTS_H
+
+#include <bit>
+#include <cstdint>
+
+class Timeline;
+
+class InterruptController {
+    public:
+        enum Kind : uint8_t {
+            VBlank = (1 << 0),
+            LCD = (1 << 1),
+            Timer = (1 << 2),
+            Serial = (1 << 3),
+            Joypad = (1 << 4)
+        };
+        static constexpr const char* names[] = {"VBlank", "LCD", "Timer", "Serial", "Joypad"}; // by bit, for the reports
+
+        void request(Kind kind) { if (timeline_) record_(kind); if_ |= kind; update_(); };
+        void acknowledge(int interrupt) { if_ &= ~(1 << interrupt); update_(); }; // clear the IF bit of a dispatched interrupt
+        uint8_t pending() { return pending_; }; // requested and enabled
+        uint8_t ready() { return ready_; }; // requested and enabled while IME is set: to be dispatched
+        int highest() { return std::countr_zero(static_cast<unsigned int>(pending_)); }; // the bit of the interrupt dispatched first (if any is pending)
+
+        uint8_t read_if() { return if_; };
+        void write_if(uint8_t value) { if_ = value; update_(); };
+        uint8_t read_ie() { return ie_; };
+        void write_ie(uint8_t value) { ie_ = value; update_(); };
+        bool ime() { return ime_; };
+        void set_ime(bool ime) { ime_ = ime; update_(); };
+
+        void set_timeline(Timeline* timeline) { timeline_ = timeline; }; // record the requests on the timeline (see timeline.h)
+    private:
+        void update_() { pending_ = ie_ & if_ & 0x1f; ready_ = ime_ ? pending_ : 0; };
+        void record_(Kind kind);
+
+        uint8_t if_ = 0; // interrupt flag
+        uint8_t ie_ = 0; // interrupt enable
+        bool ime_ = false; // interrupt master enable (write only). Starts disabled when game begins
+        uint8_t pending_ = 0;
+        uint8_t ready_ = 0;
+        Timeline* timeline_ = nullptr;
+};
+
+#endif
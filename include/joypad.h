@@ -9,6 +9,20 @@ class Joypad
         void set_selection(uint8_t value); // write to the top two selection bits
         void set_dpad(uint8_t value);
         void set_buttons(uint8_t value);
+        void set_state(uint8_t pressed); // set every button at once from a mask of pressed buttons (see buttons below)
+
+        // bit of each button in the set_state mask. The lower nibble is the dpad, the upper nibble the SsBA buttons, in
+        // the same order as the (active low) bits of the joypad register
+        enum buttons {
+            Right = (1 << 0),
+            Left = (1 << 1),
+            Up = (1 << 2),
+            Down = (1 << 3),
+            A = (1 << 4),
+            B = (1 << 5),
+            Select = (1 << 6),
+            Start = (1 << 7)
+        };
 
         uint8_t get_dpad(); // get the lower read only 4 bits
         uint8_t get_buttons(); // get the lower read only 4 bits
@@ -2,34 +2,60 @@
 #define MBC_H
 
 #include <cstdint>
+#include <memory>
+#include <string>
 #include <unistd.h>
 #include <vector>
 #include <iostream>
 #include <unordered_map>
+#include "save_ram.h"
+
+class CPU;
 
 class MBC
 {
     public:
-        // constructor for all MBCs saves cartridge data for MBC reference
-        MBC(std::vector<uint8_t> cartridge) :
-         cartridge_data_(cartridge), rom_size_code(cartridge[0x0148]), external_ram_size_code(cartridge[0x0149]) {};
+        // constructor for all MBCs saves cartridge data for MBC reference, and creates the external RAM the header asks for,
+        // kept in save_file if one is given (battery-backed cartridges)
+        MBC(std::vector<uint8_t> cartridge, std::string save_file = "", size_t save_footer_size = 0) :
+         cartridge_data_(cartridge), rom_size_code(cartridge[0x0148]), external_ram_size_code(cartridge[0x0149])
+        {
+            uint ram_size = ram_code_to_size_.contains(external_ram_size_code) ? ram_code_to_size_.at(external_ram_size_code) : 0;
+            external_ram_ = std::make_unique<SaveRAM>(ram_size, save_file, save_footer_size);
+        };
+        virtual ~MBC() {};
 
         // given the address, read from different banks / external RAM depending on the MBC. Base class returns invalid read
         virtual uint8_t read(uint16_t address) { return 0xff; }; 
         virtual void write(uint16_t address, uint8_t value) {};  // write to different MBC registers
+        // the byte read at address and the rest of its 256-byte page, if they are plain ROM or RAM (for OAM DMA). nullptr
+        // if they are not memory (disabled RAM, the RTC registers)
+        virtual const uint8_t* memory(uint16_t address) { return nullptr; };
 
         uint8_t get_external_ram_size_code() { return external_ram_size_code; };
         uint8_t get_rom_size_code() { return rom_size_code; };
+        virtual uint16_t rom_bank() { return rom_bank_number_; }; // ROM bank currently mapped to 0x4000 - 0x7fff
+        virtual void set_rtc_clock(CPU* cpu) {}; // the time source of the real-time clock, if the cartridge has one (see mbc3.h)
 
     protected:
         // cartridge metadata
         uint8_t external_ram_size_code;
         uint8_t rom_size_code;
         std::vector<uint8_t> cartridge_data_;
+        std::unique_ptr<SaveRAM> external_ram_;
+
+        // the RAM enable register changed: a disabled RAM is how games end a save, so write it to disk
+        void set_ram_enable_(bool enable)
+        {
+            if (ram_enable_ && !enable) {
+                external_ram_->flush();
+            }
+            ram_enable_ = enable;
+        };
 
-        // possible registers required by MBCs. All registers default to 0x00 on power up
+        // possible registers required by MBCs. All registers default to 0x00 on power up (a ROM bank of 0 selects bank 1)
         bool ram_enable_ = false; // RAM enable needs to be activated first by writing $A to memory
-        uint8_t rom_bank_number_ = 0x0; 
+        uint8_t rom_bank_number_ = 0x1; 
         uint8_t ram_bank_reg_ = 0x0;
         uint8_t banking_mode_ = 0x0;
 
@@ -8,9 +8,15 @@
 class MBC1 : public MBC 
 {
     public:
-        MBC1(std::vector<uint8_t> cartridge) : MBC(cartridge) {}; // MBC type 0x1
+        MBC1(std::vector<uint8_t> cartridge, std::string save_file = "") : MBC(cartridge, save_file) {}; // MBC types 0x1 - 0x3
         uint8_t read(uint16_t address) override; // Read the byte at the address in the cartridge based on the behaviour of MBC1
         void write(uint16_t address, uint8_t value) override; // write to the MBC registers
+        const uint8_t* memory(uint16_t address) override;
+        uint16_t rom_bank() override { return (ram_bank_reg_ << 5) | rom_bank_number_; }; // the secondary register holds the upper bank bits
+    private:
+        uint32_t upper_bank_(); // the ROM bank bits the secondary register adds (bits 5 - 6)
+        uint32_t rom_address_(uint32_t bank, uint16_t address); // offset into the ROM of an address in a 16 KiB bank
+        uint32_t ram_address_(uint16_t address); // offset into the external RAM of an address in 0xa000 - 0xbfff
 
 };
 
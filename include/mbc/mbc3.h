@@ -1,3 +1,19 @@
+/*
+mbc3.h: header file for mbc3.cpp
+
+The real-time clock of the timer cartridges (0x0f, 0x10) is not ticked: it is kept as the time its counter was zero
+(rtc_base_) in the seconds of a time source, or as the stopped counter while halted, and the registers are only
+computed when the game latches them. The time source is the host's wall clock by default, or the CPU's cycle count
+(set_rtc_clock), which keeps movies and headless runs deterministic and makes fast-forwarding advance the clock with the
+game.
+
+With a save file, the clock is kept in the 48 byte footer after the RAM used by other emulators (BGB, VBA-M): the
+current and latched registers as 32-bit little-endian values, and the 64-bit UNIX time they were saved at. It is
+written when the game writes the clock's registers, disables the RAM (as games do after saving) and when the emulator
+exits, not on every latch: games latch constantly, and every footer write would have the save file synced again. With
+the host clock the time the emulator was not running is added on load, with the emulated clock it is not.
+*/
+
 #ifndef MBC3_H
 #define MBC3_H
 
@@ -6,18 +22,40 @@
 #include <vector>
 #include <array>
 
+class CPU;
+
 class MBC3 : public MBC 
 {
     public:
-        MBC3(std::vector<uint8_t> cartridge) : MBC(cartridge) { external_ram = std::vector<uint8_t>(ram_code_to_size_.at(external_ram_size_code), 0); }; // MBC type 0x1
+        MBC3(std::vector<uint8_t> cartridge, std::string save_file = "", bool has_rtc = false) :
+            MBC(cartridge, save_file, has_rtc ? rtc_footer_size : 0), has_rtc_(has_rtc) {}; // MBC types 0x0f - 0x13
+        ~MBC3() override;
         uint8_t read(uint16_t address) override; // Read the byte at the address in the cartridge based on the behaviour of MBC1
         void write(uint16_t address, uint8_t value) override; // write to the MBC registers
+        const uint8_t* memory(uint16_t address) override;
+        void set_rtc_clock(CPU* cpu) override; // count time in the CPU's cycles, or on the host's clock if nullptr
+
+        static const size_t rtc_footer_size = 48;
     private:
         void latch_clock();
-        std::vector<uint8_t> external_ram;
+        void start_rtc_(); // set the clock going from the save file footer, on first use
+        double now_(); // the time source, in seconds
+        double counter_(); // seconds since the clock's day 0 (as the registers count them)
+        void set_counter_(double seconds);
+        void write_rtc_(uint8_t reg, uint8_t value); // a write to one of the registers (0x08 - 0x0c)
+        void write_rtc_footer_();
     private:
+        bool has_rtc_;
+        CPU* rtc_cpu_ = nullptr;
+        bool rtc_started_ = false;
+        double rtc_base_ = 0; // the time source's seconds at which the counter was 0, while running
+        double rtc_halted_counter_ = 0; // the counter, while halted
+        bool rtc_halted_ = false; // DH bit 6
+        bool rtc_carry_ = false; // DH bit 7, set when the 9-bit day counter overflows, until written
+
         bool rtc_rw_enable_ = false;
         uint8_t latch_clock_data_ = 0;
+        // the latched registers, as read by the game
         uint8_t rtc_s = 0;
         uint8_t rtc_m = 0;
         uint8_t rtc_h = 0;
@@ -25,4 +63,4 @@ class MBC3 : public MBC
         uint8_t rtc_dh = 0;
 };
 
-#endif
\ No newline at end of file
+#endif
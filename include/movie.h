@@ -0,0 +1,33 @@
+/*
+movie.h: header file for movie.cpp
+
+A movie is a recording of joypad input, replayed frame by frame so that a run of a ROM is reproducible
+(golden-frame regression tests, benchmarks). Movies are text files with one input change per line:
+
+    # frame  buttons
+    0        -
+    120      START
+    125      -
+    300      A,RIGHT
+
+The buttons (RIGHT, LEFT, UP, DOWN, A, B, SELECT, START, or - for none) are held from that frame until the next line.
+*/
+
+#ifndef MOVIE_H
+#define MOVIE_H
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+class Movie {
+    public:
+        void load_movie_from_file(std::string movie_file); // throws std::runtime_error if it cannot be opened or read
+        uint8_t input_for_frame(uint64_t frame); // pressed buttons (Joypad::buttons mask) during the given frame
+
+    private:
+        std::vector<std::pair<uint64_t, uint8_t>> changes_; // (first frame, pressed buttons), sorted by frame
+};
+
+#endif
@@ -0,0 +1,59 @@
+/*
+perf_counters.h: header file for perf_counters.cpp
+
+Hardware performance counters (Linux perf_event_open, no libraries needed) read around regions of the emulator:
+    frame:    the whole emulation loop of a frame
+    cpu:      CPU cycles, sampled on every Instrumentation::sample_stride'th master clock cycle and scaled up
+              (reading the counters around every CPU tick would cost more than the tick)
+    render:   every PPU scanline render, or with the pixel FIFO engine every 16th dot of mode 3, scaled up like the CPU's
+    present:  uploading and presenting the frame (on the presentation thread, with its own counters added at the end)
+
+The counters count the thread that made them. They are read in user space with rdpmc where the kernel allows it, and
+with read() otherwise. What reading the counters itself counts is measured once at start up and subtracted from every
+region, which matters for the sampled CPU region (a single CPU tick costs less than reading six counters). The report
+gives IPC, and misses per emulated instruction, so runs of different lengths can be compared before and after an
+optimization. On other systems (or when the kernel refuses, see /proc/sys/kernel/perf_event_paranoid) available()
+is false and every call does nothing.
+*/
+
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+
+class PerfCounters {
+    public:
+        enum Counter { Cycles, Instructions, BranchMisses, L1IMisses, L1DMisses, LLCMisses, counter_count };
+        enum Region { Frame, CPU, Render, Present, region_count };
+        using Counts = std::array<uint64_t, counter_count>;
+
+        PerfCounters();
+        ~PerfCounters();
+        bool available() { return available_; };
+
+        void begin(Region region) { if (available_) { read_(start_[region]); } };
+        void end(Region region, uint64_t scale = 1); // add the counts since begin (times scale, for sampled regions), less the cost of reading them
+        void set_emulated_instructions(uint64_t instructions) { emulated_instructions_ = instructions; };
+        const Counts& totals(Region region) { return totals_[region]; };
+        void add(Region region, const PerfCounters& other); // add the region's counts of another thread's counters
+
+        void write_report(std::ostream& out);
+
+    private:
+        void read_(Counts& counts);
+        uint64_t read_counter_(int counter);
+        void calibrate_(); // measure what an empty begin / end pair counts
+
+        bool available_ = false;
+        std::array<int, counter_count> fds_;
+        std::array<void*, counter_count> pages_ {}; // mmapped perf_event_mmap_page, for rdpmc
+        std::array<Counts, region_count> start_ {};
+        std::array<Counts, region_count> totals_ {};
+        std::array<uint64_t, region_count> calls_ {};
+        Counts overhead_ {};
+        uint64_t emulated_instructions_ = 0;
+};
+
+#endif
\ No newline at end of file
@@ -1,17 +1,19 @@
 #ifndef PPU_H
 #define PPU_H
 
-#include <SDL_render.h>
-#include <SDL_video.h>
 #include <_types/_uint8_t.h>
+#include <algorithm>
 #include <cstdint>
 #include <array>
+#include <memory>
 #include <vector>
+#include "interrupts.h"
+#include "raster.h"
 
-#define SCREEN_HEIGHT 144
-#define SCREEN_WIDTH 160
+#define LCD_OFF_SHADE 4 // shade written to the framebuffer while the LCD is switched off (plain white)
 
 class Bus; // forward declaration of class Bus
+class PerfCounters;
 
 class PPU {
     private:
@@ -22,37 +24,149 @@ class PPU {
         ~PPU();
 
         void connect_bus(Bus* bus);
+        void connect_interrupts(InterruptController* interrupts);
 
         uint8_t read(uint16_t address); // read a PPU register, VRAM or OAM
         void write(uint16_t address, uint8_t value); // write to the PPU registers
-        void clear_screen();
-        void render(); // use SDL to draw the current texture to the screen
-        void cycle(); // go through one PPU cycle (process 1 frame)
-
-        void display_frame_rate(float frame_rate); // show the frame rate in the title of the window
+        // go through one PPU cycle. Nothing happens between the scheduled events (the end of each mode): the cycle only counts
+        // down to the next one
+        void cycle() { if (--cycles_to_event_ == 0) event_(); };
+        uint32_t idle_cycles(); // how many of the next cycles only count down to the next mode change (nothing visible happens)
+        void skip(uint32_t cycles); // let up to idle_cycles() cycles pass at once
+        uint32_t quiet_cycles(); // how many of the last cycles were idle
+
+        // the finished picture: one shade (0-3, or LCD_OFF_SHADE) per pixel, after the palettes have been applied
+        const std::array<uint8_t, SCREEN_WIDTH * SCREEN_HEIGHT>& framebuffer() { return framebuffer_; };
+        const std::array<uint8_t, SCREEN_WIDTH * SCREEN_HEIGHT>& completed_frame() { collect_frame_(); return completed_frame_; }; // copy of the framebuffer taken when the last frame was completed
+        uint64_t frame_hash() { collect_frame_(); return frame_hash_; }; // hash of the last completed frame
+        // the last completed frame without waiting for the deferred renderer: until the frame it is drawing is done (see
+        // poll_frame), the one before. ready_frame_number() is the frame_count() it was completed at
+        const std::array<uint8_t, SCREEN_WIDTH * SCREEN_HEIGHT>& ready_frame() { return completed_frame_; };
+        uint64_t ready_hash() { return frame_hash_; };
+        uint64_t ready_frame_number() { return completed_number_; };
+        void poll_frame(); // complete the frame the deferred renderer is drawing if its threads are done with it
+        uint64_t frame_count() { return frame_count_; }; // number of frames completed so far
+        void attach_perf_counters(PerfCounters* perf_counters) { perf_counters_ = perf_counters; }; // count every scanline render (nullptr to stop)
+
+        // OAM DMA (0xff46): the transfer is scheduled, not performed. It starts an m-cycle after the write and takes 160
+        // m-cycles, during which the CPU can only reach the I/O registers and HRAM (the bus swaps its memory map, see
+        // Bus::write). The 160 bytes are copied at once, straight from the source page, by the first access of the CPU or
+        // the PPU at or after the end: only the CPU writes the source (or switches its bank), and it is cut off until then,
+        // so the source is still what the transfer read. A new transfer started during one first copies the bytes the old
+        // one got to
+        void start_oam_dma(uint8_t source, uint64_t cycle);
+        bool oam_dma_blocks(uint64_t cycle) { return cycle >= dma_blocked_from_ && cycle < dma_end_; }; // the CPU is cut off from the memory below 0xff00
+        bool finish_oam_dma(); // copy the transfer to OAM if it has ended. False while one is still running
+
+        // the engine drawing the pixels. The scanline renderer draws each line at once at the start of mode 3 (fast), the
+        // pixel FIFO engine (ppu_fifo.cpp) one pixel per dot through the background fetcher and the two FIFOs, as the
+        // hardware does, so that registers written during mode 3 take effect mid-line (accurate). The deferred renderer
+        // draws the same as the scanline renderer, but only logs each line's state at the start of its mode 3: the frame is
+        // drawn from the log at VBlank by the Rasterizer's threads (raster.h), while the next frame is emulated. All use
+        // the same VRAM, OAM and registers; a change takes effect from the next line
+        enum class Renderer { Scanline, PixelFifo, Deferred };
+        void set_renderer(Renderer renderer);
+        Renderer renderer() { return renderer_; };
+        void set_raster_threads(int threads); // the deferred renderer's worker threads (0: the emulating one draws)
+
+        // whether the frames are drawn, from the next one on: it is looked at as the first line's mode 3 starts, so a frame
+        // is drawn whole or not at all. A frame not drawn keeps everything else (the mode 3 lengths, the STAT and LY changes
+        // and the interrupts), so frames can be skipped without changing the emulation; completed_frame() and frame_hash()
+        // stay those of the last frame drawn. The pixel FIFO engine's mode 3 length comes from fetching the pixels, so it
+        // always draws
+        void set_rendering(bool render) { render_ = render; };
+        bool frame_rendered() { return frame_rendered_; }; // the last frame finished (at VBlank, or LCD off) was drawn whole
 
         // registers
         uint8_t read_ly();
 
     private:
-        SDL_Window* window_;
-        SDL_Renderer* renderer_;
-        SDL_Texture* texture_;
-
-        std::array<uint8_t, SCREEN_WIDTH * SCREEN_HEIGHT> frame_background_colour;
+        std::array<uint8_t, SCREEN_WIDTH * SCREEN_HEIGHT> framebuffer_;
+        std::array<uint8_t, SCREEN_WIDTH * SCREEN_HEIGHT> completed_frame_;
+        uint64_t frame_hash_ = 0;
+        uint64_t completed_number_ = 0; // frame_count_ when completed_frame_ was completed
+        uint64_t rasterizing_number_ = 0; // and when the frame being drawn was
+        uint64_t frame_count_ = 0;
+        void finish_frame(); // called when a frame has been completed
+        bool render_ = true;
+        bool rendering_ = true; // render_, as the frame being drawn started
+        int lines_drawn_ = 0; // of the frame being drawn
+        bool frame_rendered_ = true;
 
         Bus* bus_; // hold a reference to the bus
-
-        uint16_t t_cycles_delay_ = 80; // start in mode 2, which lasts 80 "dots"
-
-        void set_mode(uint8_t mode); // set the mode and handle the resulting possible STAT interrupt
-        void draw_scanline();
-        void draw_bg_window();
-        void draw_sprites();
-        void set_colour_from_palette(int* r, int* g, int* b, uint8_t colour_ID, uint8_t palette);
+        InterruptController* interrupts_; // to request the VBlank and STAT interrupts
+        PerfCounters* perf_counters_ = nullptr;
+
+        uint32_t cycles_to_event_ = UINT32_MAX; // calls to cycle() until the current mode ends (the LCD starts off)
+        uint32_t mode_length_ = 0; // cycles_to_event_ at the last mode change
+        uint64_t lcd_off_at_ = 0; // cycle the LCD was switched off at
+        bool stat_line_ = false; // the STAT interrupt line: the OR of the enabled STAT sources
+
+        void event_(); // the current mode has ended: switch to the next one and schedule its end
+        void schedule_(uint32_t cycles); // the next event is in this many cycles
+        void switch_lcd_(); // LCDC bit 7 changed: start the first line, or stop and blank the screen
+        void set_mode(uint8_t mode); // set the mode (the STAT line is updated by the caller)
+        uint32_t drawing_length_(); // the length of mode 3 on this line, from SCX, the window and the objects found by oam_scan
+        uint32_t object_stall_(uint8_t x, bool window, uint64_t& waited); // the dots an object at X adds to mode 3
+        uint32_t drawing_ = 172; // the length of the current line's mode 3
+        void compare_lyc_(); // set the LY == LYC bit
+        // the window is drawn on this line: enabled (LCDC.5, and LCDC.0, which blanks it on the DMG), reached (WY <= LY)
+        // and not right of the screen (WX <= 166). Drawn and skipped lines alike advance its line counter by it
+        bool window_visible_on_line_() { return lcdc_.enable_priority && lcdc_.window_enable && wy_ <= ly_ && wx_ <= 166; };
+        void update_stat_line_(); // recompute the STAT line, requesting the interrupt on a rising edge
+        void draw_scanline(); // draw the line with the scanline renderer, or log it for the deferred renderer
+        LineState capture_line_(); // the registers and objects the scanline renderer draws the line from
+        uint8_t window_line_ = 0; // the window's line counter: lines of this frame the window was drawn on
+        bool window_drawn_ = false; // the window is drawn on the current line
+
+        // the deferred renderer: lines are logged to logs_[log_] while the other one may still be being drawn
+        std::array<FrameLog, 2> logs_;
+        int log_ = 0;
+        std::unique_ptr<Rasterizer> rasterizer_; // made when the deferred renderer is first selected
+        int raster_threads_ = std::min(3, std::max(0, static_cast<int>(std::thread::hardware_concurrency()) - 1));
+        bool rasterizing_ = false; // the last frame is still being drawn
+        void collect_frame_(); // wait for the frame being drawn, and complete it
+        uint8_t get_shade_from_palette(uint8_t colour_ID, uint8_t palette);
+
+        // -- PIXEL FIFO ENGINE (ppu_fifo.cpp) --
+        Renderer renderer_ = Renderer::Scanline;
+        struct ObjectPixel {
+            uint8_t colour = 0; // colour ID, 0 is transparent
+            uint8_t palette = 0; // OBP1 rather than OBP0
+            uint8_t behind = 0; // the background's colours 1 - 3 are drawn over it
+        };
+        struct PixelFifo {
+            uint8_t delay = 6; // dots until the fetcher starts (the first fetch of a line is thrown away)
+            uint8_t step = 0; // dots into the fetch of the current tile: tile number, low byte, high byte (2 dots each), then push
+            uint8_t tile_x = 0; // tiles fetched since the line (or the window) started
+            uint8_t tile = 0;
+            uint8_t low = 0;
+            uint8_t high = 0;
+            bool window = false; // fetching the window's tiles
+            std::array<uint8_t, 8> background {}; // colour IDs, only refilled once empty
+            uint8_t background_count = 0; // pixels left, the next one is background[8 - background_count]
+            std::array<ObjectPixel, 8> objects {}; // the object pixels over the next 8 pixels, objects[object_head] over the next
+            uint8_t object_head = 0;
+            std::array<uint8_t, 10> sprites {}; // the OAM offsets of the line's objects, from left to right
+            uint8_t sprite_count = 0;
+            uint8_t next_sprite = 0;
+            uint8_t stall = 0; // dots left of an object fetch, nothing moves meanwhile
+            uint64_t waited = 0; // the tiles objects waited for (see object_stall_)
+            uint8_t discard = 0; // pixels of the first tile left to throw away (SCX % 8)
+            uint8_t x = 0; // the next pixel on the line
+            bool drawing = false; // the line has been started, and not all of its pixels are out
+        };
+        PixelFifo fifo_;
+        void fifo_start_line_(); // mode 3 starts: reset the fetcher and the FIFOs
+        void fifo_render_dot_(); // fifo_dot_, sampled by the perf counters
+        static constexpr uint32_t render_sample_stride = 16; // dots per dot counted
+        void fifo_dot_(); // one dot of mode 3
+        void fifo_fetch_(); // one dot of the background / window fetcher
+        void fifo_fetch_sprite_(); // put the next object's pixels in the object FIFO, and stall for it
+        void fifo_output_(); // pop a pixel from the FIFOs onto the screen
 
         void oam_scan(); // during mode 2, perform the oam_scan, which finds up to 10 sprites to display
-        void oam_dma_transfer(uint8_t value); // when requested perform an OAM DMA transfer
+        void copy_oam_dma_(int bytes); // copy the first bytes of the transfer
         std::vector<int> scanline_sprites_; // up to 10 sprites that can be displayed on a scanline
         
         // -- REGISTERS -- 
@@ -70,6 +184,10 @@ class PPU {
         uint8_t lyc_ = 0;
 
         uint8_t dma_source_ = 0;
+        bool dma_pending_ = false; // a transfer has been started but not copied to OAM yet
+        uint64_t dma_start_ = 0; // cycle of the first byte of the transfer
+        uint64_t dma_end_ = 0; // cycle after the last byte
+        uint64_t dma_blocked_from_ = 0; // the start of the first of back to back transfers
 
         bool screen_cleared_ = true; // PPU and LCD start as "off". Checks if screen is filled white, so we don't need to process it every frame if already cleared
         // ---- STATUS AND CONTROL REGISTERS ----
@@ -86,8 +204,8 @@ class PPU {
             uint8_t ppu_mode_ = 2; // start in mode 2 by default (OAM scan)
 
             void set(uint8_t new_lcdc); // set READ/WRITE bits
-            bool set_lyc_equals(uint8_t ly, uint8_t lyc); // set READ-ONLY LYC == LY bit
-            bool set_mode(uint8_t mode); // set READ-ONLY mode bit
+            void set_lyc_equals(uint8_t ly, uint8_t lyc); // set READ-ONLY LYC == LY bit
+            void set_mode(uint8_t mode); // set READ-ONLY mode bit
         };
 
         // lcdc register
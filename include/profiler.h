@@ -0,0 +1,104 @@
+/*
+profiler.h: header file for profiler.cpp
+
+Profiles where the guest (the game) spends its emulated cycles. The CPU reports every instruction fetch; the profiler
+keeps a cycle histogram per (ROM bank, PC), and a shadow call stack built from the CALL / RST / RET / RETI instructions
+and interrupt dispatch, so cycles can also be attributed to whole call paths.
+
+Two modes:
+    exact:    every instruction's cycles (from its fetch to the next fetch) are counted
+    sampling: about every sample_period cycles (randomly jittered, to avoid locking onto the frame loop), the
+              instruction executing at that moment is charged with the whole period. The call stack is still tracked exactly, so the per-instruction cost is a
+              compare and a table lookup
+
+Results are written as a top-N report (cycles per function, using the RGBDS .sym file if one is loaded) and as
+folded stacks for flame graph tools (e.g. flamegraph.pl, speedscope). The CPU hook is only compiled in when GB_PROFILE
+is defined (cmake -DGAMEBOY_PROFILE=ON).
+*/
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Cartridge;
+
+class Profiler {
+    public:
+        Profiler(Cartridge* cartridge, bool exact, uint32_t sample_period = 1000);
+
+        void load_symbols(std::string sym_file); // RGBDS .sym file ("BB:AAAA Name" lines). Throws std::runtime_error if it cannot be opened
+
+        // CPU hooks
+        void instruction(uint16_t pc, uint8_t opcode, uint16_t sp, uint64_t cycle)
+        {
+            if (cycle >= next_sample_) {
+                sample_(cycle);
+            }
+            // the previous instruction was a call or a return: see whether it was taken, now that it has executed
+            if (pending_ != None) {
+                resolve_branch_(pc, sp);
+            }
+            pending_ = branch_kind_[opcode];
+            pending_sp_ = sp;
+            previous_pc_ = pc;
+        };
+        void interrupt(uint16_t return_pc, uint16_t handler, uint16_t sp); // called after the return address was pushed
+
+        void write_report(std::ostream& out, size_t top); // top functions and instructions by cycles
+        void write_folded(std::ostream& out); // "frame;frame;frame cycles" lines
+        uint64_t total_cycles() { return total_cycles_; };
+
+    private:
+        enum BranchKind : uint8_t { None, Call, Return };
+        static const std::array<BranchKind, 256> branch_kind_;
+
+        struct Node {
+            uint32_t function; // bank << 16 | address of the called function
+            uint32_t parent;
+            uint64_t cycles = 0; // self cycles
+        };
+        struct Frame {
+            uint32_t node;
+            uint16_t sp; // stack pointer just after the return address was pushed
+        };
+
+        uint32_t location_(uint16_t address); // bank << 16 | address
+        void resolve_branch_(uint16_t pc, uint16_t sp);
+        void enter_(uint32_t function, uint16_t sp);
+        void sample_(uint64_t cycle);
+        std::string name_(uint32_t location, bool offset); // symbol (+ offset), or BB:AAAA
+
+        Cartridge* cartridge_;
+        bool exact_;
+        uint32_t sample_period_;
+        uint64_t next_sample_ = 0;
+        uint64_t random_ = 0x9e3779b97f4a7c15ULL; // xorshift state for the sample jitter
+
+        // the instruction fetched last, which was executing until now
+        BranchKind pending_ = None;
+        uint16_t pending_sp_ = 0;
+        uint16_t previous_pc_ = 0;
+
+        uint64_t last_cycle_ = 0; // cycle of the last sample
+        uint64_t total_cycles_ = 0;
+
+        // cycles per location: one array for the unbanked address space (and ROM bank 0), one per switchable ROM bank
+        std::vector<uint64_t> unbanked_cycles_;
+        std::vector<std::unique_ptr<std::array<uint64_t, 0x4000>>> banked_cycles_;
+
+        std::vector<Node> nodes_; // call tree, node 0 is the root (code not called from anywhere we saw)
+        std::unordered_map<uint64_t, uint32_t> children_; // parent node << 32 | function -> child node
+        std::vector<Frame> stack_;
+
+        std::map<uint32_t, std::string> symbols_; // bank << 16 | address -> name
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,90 @@
+/*
+raster.h: header file for raster.cpp
+
+The scanline renderer. A line is drawn from a LineState, everything it reads captured when the line's mode 3 starts
+(the scroll, window and palette registers, LCDC, the window's line counter and the OAM entries of the line's objects),
+and from VRAM. So a line can be drawn right away, or logged and drawn later.
+
+A FrameLog holds a frame's lines: their states, VRAM as it was when the first line was logged, and a journal of the
+VRAM writes made between the lines. The Rasterizer draws a log at VBlank, split in bands of lines over worker threads:
+each band starts from the logged VRAM with the journal applied up to its first line, and applies the rest as it goes,
+so every line sees VRAM as it was when it was logged. Only the emulation thread touches the PPU, the workers only read
+the log and write their own rows of the frame, so the emulation thread draws nothing unless there are no workers.
+*/
+
+#ifndef RASTER_H
+#define RASTER_H
+
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define SCREEN_HEIGHT 144
+#define SCREEN_WIDTH 160
+
+struct LineState {
+    uint8_t ly;
+    uint8_t scx;
+    uint8_t scy;
+    uint8_t wx;
+    uint8_t wy;
+    uint8_t lcdc;
+    uint8_t bgp;
+    uint8_t obp0;
+    uint8_t obp1;
+    uint8_t window_line; // the window's own line counter: the lines it was drawn on before this one in the frame
+    uint8_t sprite_count;
+    std::array<uint8_t, 40> sprites; // the OAM entries of the line's objects, in OAM order
+};
+
+// draw one line into row (SCREEN_WIDTH shades) from its state and VRAM (0x8000 - 0x9fff)
+void draw_line(const LineState& line, const uint8_t* vram, uint8_t* row);
+
+struct FrameLog {
+    struct VramWrite {
+        uint16_t address; // from 0x8000
+        uint8_t value;
+        uint8_t line; // the number of lines logged before the write
+    };
+    std::array<uint8_t, 0x2000> vram; // when the first line was logged
+    std::vector<VramWrite> journal;
+    std::vector<LineState> lines; // in the order they were logged
+
+    void clear() { journal.clear(); lines.clear(); };
+};
+
+class Rasterizer {
+    public:
+        Rasterizer(int threads); // the worker threads drawing the bands. With none, the calling thread draws the frame
+        ~Rasterizer();
+        Rasterizer(const Rasterizer&) = delete;
+        Rasterizer& operator=(const Rasterizer&) = delete;
+
+        // draw the log's lines into framebuffer (whose rows for lines not in the log are left alone): the workers start on
+        // their bands now (without workers, the calling thread draws them all in finish()). Both stay untouched until then
+        void start(const FrameLog* log, uint8_t* framebuffer);
+        void finish(); // wait for the workers
+        bool busy() { return log_ != nullptr; };
+        bool drawn(); // finish() would not wait: the workers are done (or there are none)
+
+    private:
+        void worker_(int band);
+        void draw_band_(int band); // draw band of bands_ of the log's lines
+
+        std::vector<std::thread> workers_;
+        int bands_;
+        const FrameLog* log_ = nullptr;
+        uint8_t* framebuffer_ = nullptr;
+
+        std::mutex mutex_;
+        std::condition_variable start_;
+        std::condition_variable done_;
+        uint64_t generation_ = 0; // frames started, the workers wait for it to change
+        int running_ = 0; // workers still drawing the current frame
+        bool stop_ = false;
+};
+
+#endif
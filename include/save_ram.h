@@ -0,0 +1,70 @@
+/*
+save_ram.h: header file for save_ram.cpp
+
+A cartridge's external RAM. Without a battery it is plain memory, lost when the emulator exits. With one it is a
+shared memory mapping of the .sav file next to the ROM, so every write goes straight into the page cache: even if the
+emulator crashes, the kernel still writes the pages back. To bound what an OS crash or power loss can take, a writer
+thread msyncs the file whenever the game disables the RAM (which games do after saving) and every flush_interval while
+there are unwritten changes. A write to the RAM only sets a flag; a disable (a few times per save) takes the writer's
+lock for long enough to wake it, the msync itself is never waited for.
+
+A .sav file shorter than the RAM (e.g. new) is extended with zeros; a longer one keeps its extra bytes (such as an RTC
+footer, see footer()).
+*/
+
+#ifndef SAVE_RAM_H
+#define SAVE_RAM_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class SaveRAM {
+    public:
+        // size bytes of RAM, mapped from save_file followed by footer_size more bytes if a file is given
+        SaveRAM(size_t size, const std::string& save_file = "", size_t footer_size = 0);
+        ~SaveRAM();
+        SaveRAM(const SaveRAM&) = delete;
+        SaveRAM& operator=(const SaveRAM&) = delete;
+
+        size_t size() { return size_; };
+        uint8_t read(size_t address) { return data_[address]; };
+        void write(size_t address, uint8_t value)
+        {
+            if (data_[address] != value) {
+                data_[address] = value;
+                dirty_.store(true, std::memory_order_relaxed);
+            }
+        };
+        const uint8_t* data() { return data_; }; // the RAM, for reading it directly (writes go through write())
+        uint8_t* footer() { return data_ + size_; }; // the footer_size bytes stored after the RAM (mark_dirty() after changing them)
+        void mark_dirty() { dirty_.store(true, std::memory_order_relaxed); };
+        bool persistent() { return fd_ >= 0; }; // backed by a file
+        void flush(); // have the writer thread write the changes to disk now (the game disabled the RAM)
+
+        static constexpr std::chrono::seconds flush_interval {2};
+    private:
+        void writer_(); // the writer thread
+        void sync_(); // msync the mapping if it changed
+
+        uint8_t* data_ = nullptr;
+        size_t size_;
+        std::vector<uint8_t> memory_; // without a file (or if mapping it failed)
+        int fd_ = -1;
+        size_t mapped_ = 0;
+
+        std::atomic<bool> dirty_ {false};
+        std::thread thread_;
+        std::mutex mutex_;
+        std::condition_variable wake_;
+        bool flush_requested_ = false;
+        bool stop_ = false;
+};
+
+#endif
@@ -2,6 +2,7 @@
 #define SERIAL_H
 
 #include <cstdint>
+#include <string>
 
 class Serial 
 {
@@ -10,9 +11,15 @@ class Serial
         void write_sb(uint8_t value);
         void write_sc(uint8_t value);
 
+        void set_echo(bool echo); // whether transferred characters are also printed to std::cout
+        const std::string& output() { return output_; }; // every character transferred so far (e.g. the text printed by blargg test ROMs)
+
     private:
         uint8_t sb_ = 0;
         uint8_t sc_ = 0;
+
+        bool echo_ = true;
+        std::string output_;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -1,8 +1,90 @@
+/*
+sound.h: header file for sound.cpp
+
+The APU (0xff10 - 0xff3f): two square channels (the first with a frequency sweep), the wave channel and the noise
+channel, the 512 Hz frame sequencer clocking their length counters, envelopes and the sweep, and the NR50 / NR51 / NR52
+volume, panning and power registers.
+
+Nothing is done per cycle. The APU only catches up to the CPU's cycle count when a register is read or written, or when
+a frame ends: it then runs the channels from one waveform step to the next, and every time the mixed output changes it
+adds a band-limited step to the left / right StepBuffer (see step_buffer.h). Without a sample rate (headless) only
+the register state is kept up: the channels are not stepped at all, and catching up is a loop over frame sequencer
+steps.
+
+The frame sequencer steps on every 8192nd cycle since power on, rather than following DIV (so writing DIV does not
+move it).
+*/
+
 #ifndef SOUND_H
 #define SOUND_H
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include "step_buffer.h"
+
 class Sound {
+    public:
+        void set_sample_rate(int sample_rate); // start producing samples at this rate (0 to stop)
+        uint8_t read(uint16_t address, uint64_t cycle);
+        void write(uint16_t address, uint8_t value, uint64_t cycle);
+        void end_frame(uint64_t cycle); // catch up to cycle, and make the samples up to it available
+        size_t samples_available() { return left_.samples_available(); };
+        size_t read_samples(int16_t* out, size_t count); // up to count interleaved stereo samples, returns how many were read
+        // produce ratio times as many samples from now on (to keep an audio buffer at its level, see audio_output.h). Only
+        // right after all the available samples were read
+        void set_rate_adjustment(double ratio) { left_.set_ratio(ratio); right_.set_ratio(ratio); };
+
+        // NR52 reports which channels are on, and that changes on frame sequencer steps: for idle loops reading it, how many
+        // of the next cycles do not have a step, how many of the last cycles did not, and whether NR52 was read in the last cycles
+        uint32_t steady_cycles(uint64_t cycle) { return frame_step_cycles - 1 - cycle % frame_step_cycles; };
+        uint32_t quiet_cycles(uint64_t cycle) { return cycle % frame_step_cycles; };
+        bool status_read_within(uint64_t cycle, uint32_t cycles) { return cycle - status_read_at_ <= cycles; };
+
+        static const uint32_t clock_rate = 4194304;
+    private:
+        struct Channel {
+            bool enabled = false; // the channel is playing (NR52 bits 0 - 3)
+            bool dac = false;
+            bool length_enabled = false;
+            uint16_t length = 0; // length counter ticks left
+            uint8_t volume = 0; // set by the envelope, unused by the wave channel
+            uint8_t envelope_timer = 0;
+            uint16_t frequency = 0;
+            uint64_t next_step = 0; // cycle of the next waveform step
+            uint8_t position = 0; // duty step (square) or sample (wave)
+            uint8_t output = 0; // digital output, 0 - 15
+        };
+
+        void catch_up_(uint64_t cycle);
+        void run_channel_(int channel, uint64_t end); // step the channel's waveform up to (not including) end
+        void clock_frame_sequencer_();
+        void trigger_(int channel);
+        uint16_t sweep_frequency_(); // the next frequency of the sweep, disabling channel 1 if it overflows
+        uint32_t period_(int channel); // cycles per waveform step
+        uint8_t sample_(int channel); // the channel's digital output in its current state
+        void update_output_(int channel); // recompute the channel's output, and mix it if it changed
+        void mix_();
+        void power_off_();
+
+        static const uint32_t frame_step_cycles = clock_rate / 512;
+
+        std::array<Channel, 4> channels_;
+        std::array<uint8_t, 0x30> registers_ {}; // as last written, including wave RAM at 0x20 - 0x2f
+        bool powered_ = false;
+        uint8_t frame_step_ = 0; // the next frame sequencer step, 0 - 7
+        uint64_t time_ = 0; // the cycle the APU has caught up to
+        uint64_t status_read_at_ = UINT64_MAX / 2; // cycle NR52 was last read at
+
+        uint16_t sweep_shadow_ = 0;
+        uint8_t sweep_timer_ = 0;
+        bool sweep_enabled_ = false;
+        uint16_t lfsr_ = 0x7fff;
 
+        bool producing_ = false; // there is a sample rate
+        std::array<int, 2> mixed_ {}; // the left / right output last added to the buffers
+        StepBuffer left_;
+        StepBuffer right_;
 };
 
 #endif
\ No newline at end of file
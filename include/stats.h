@@ -0,0 +1,70 @@
+/*
+stats.h: header file for stats.cpp
+
+Execution statistics, compiled in only when GB_STATS is defined (cmake -DGAMEBOY_STATS=ON), since counting every
+instruction and memory access slows the emulator down:
+    - executed opcodes (and CB-prefixed opcodes), and pairs of consecutive opcodes (superinstruction candidates)
+    - taken / not taken conditional branches per opcode
+    - dispatched interrupts by type
+    - reads / writes per 256-byte page of the address space, and per MMIO register (0xff00 - 0xff7f, 0xffff)
+    - the number of distinct instruction addresses executed per ROM bank (the size a decode cache would need)
+
+The GameBoy writes the report to <rom name>.stats.txt when it is destroyed, so every ROM run (e.g. by the test ROM
+runner) leaves its own report.
+*/
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+struct Stats {
+    // CPU
+    std::array<uint64_t, 256> opcodes {};
+    std::array<uint64_t, 256> cb_opcodes {};
+    std::vector<uint64_t> opcode_pairs = std::vector<uint64_t>(256 * 256); // previous opcode << 8 | opcode
+    uint8_t previous_opcode = 0;
+    std::array<uint64_t, 256> branches_taken {};
+    std::array<uint64_t, 256> branches_not_taken {};
+    std::array<uint64_t, 5> interrupts {}; // VBlank, LCD, Timer, Serial, Joypad
+    std::vector<uint8_t> executed = std::vector<uint8_t>(0x10000 / 8); // bitmap of executed (bank << 16 | address), grows with the banks
+
+    // bus
+    std::array<uint64_t, 256> page_reads {};
+    std::array<uint64_t, 256> page_writes {};
+    std::array<uint64_t, 256> io_reads {}; // by the low byte of 0xffXX
+    std::array<uint64_t, 256> io_writes {};
+
+    void instruction(uint32_t location, uint8_t opcode)
+    {
+        opcodes[opcode]++;
+        opcode_pairs[(previous_opcode << 8) | opcode]++;
+        previous_opcode = opcode;
+
+        if ((location >> 3) >= executed.size()) {
+            executed.resize(((location >> 16) + 1) * (0x10000 / 8));
+        }
+        executed[location >> 3] |= 1 << (location & 7);
+    };
+    void read(uint16_t address)
+    {
+        page_reads[address >> 8]++;
+        if (address >= 0xff00) {
+            io_reads[address & 0xff]++;
+        }
+    };
+    void write(uint16_t address)
+    {
+        page_writes[address >> 8]++;
+        if (address >= 0xff00) {
+            io_writes[address & 0xff]++;
+        }
+    };
+
+    void write_report(std::ostream& out);
+};
+
+#endif
\ No newline at end of file
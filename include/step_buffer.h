@@ -0,0 +1,50 @@
+/*
+step_buffer.h: header file for step_buffer.cpp
+
+Band-limited synthesis of a signal that only ever jumps between constant levels (like the output of the APU). Instead
+of computing the signal every master clock cycle and filtering it down to the sample rate, every jump is added where
+it happens as a band-limited step: a windowed sinc impulse, picked from a table by the fractional sample position,
+added to a buffer of differences. Summing the buffer gives the signal at the sample rate without aliasing, and the
+cost only depends on the number of jumps, not on the number of cycles.
+
+Samples come out half a kernel (kernel_width / 2 samples) late, and a DC blocker removes the offset the levels have.
+*/
+
+#ifndef STEP_BUFFER_H
+#define STEP_BUFFER_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class StepBuffer {
+    public:
+        StepBuffer();
+        void set_rates(double clock_rate, int sample_rate, uint64_t cycle); // clears the buffer, which starts at cycle
+        // produce ratio times as many samples per cycle from the next sample read on (called between reading all the samples
+        // and the next step, the samples already available would be moved otherwise)
+        void set_ratio(double ratio) { samples_per_cycle_ = nominal_samples_per_cycle_ * ratio; };
+        void add_step(uint64_t cycle, int delta); // the signal changes by delta at cycle (not before the last end_frame)
+        void end_frame(uint64_t cycle); // no more steps will be added before cycle: the samples up to it can be read
+        size_t samples_available() { return available_; };
+        // read up to count samples, scaled by gain, to out[0], out[stride], ... and returns how many were read
+        size_t read_samples(int16_t* out, size_t count, int stride, float gain);
+
+        static const int kernel_width = 16; // samples a step is spread over
+    private:
+        static const int phases = 32; // fractional sample positions the kernel is tabulated for
+
+        alignas(64) std::array<std::array<float, kernel_width>, phases> kernel_ {};
+        std::vector<float> deltas_; // differences between consecutive samples, deltas_[0] is the next sample to read
+        double start_cycle_ = 0; // the cycle of the sample in deltas_[0]
+        double samples_per_cycle_ = 0;
+        double nominal_samples_per_cycle_ = 0; // at the sample rate
+        size_t available_ = 0;
+
+        float sum_ = 0; // the signal at the last sample read
+        float dc_ = 0; // its average, which the DC blocker removes
+        float dc_rate_ = 0;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,97 @@
+/*
+timeline.h: header file for timeline.cpp
+
+Records a timeline of what the host and the emulated hardware are doing, and writes it as Chrome trace event JSON
+(open it in ui.perfetto.dev or chrome://tracing). Two processes are shown:
+    Host:     the emulation thread's emulate / handover / pacing spans of every frame, and the presentation thread's
+              render / present spans, in host time
+    Game Boy: interrupt requests and dispatch, HALT / STOP, PPU modes, LCDC / STAT writes, OAM DMA and ROM bank
+              switches, in emulated time (master clock cycles since power on, shown as microseconds at 4.194304 MHz)
+
+Both start at 0, so at full speed the emulated events line up with the host frames that emulated them.
+
+Events are recorded into preallocated chunks; full chunks are handed to a writer thread, which formats and writes
+them. Nothing is allocated while recording, and if the writer falls behind events are dropped (and counted) rather
+than stalling the emulation. The presentation track is recorded by the thread presenting the frames, every other track
+by the emulation thread: each of the two fills a chunk of its own.
+*/
+
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class CPU;
+
+class Timeline {
+    public:
+        // host tracks come first, then the emulated ones
+        enum Track : uint8_t { Host, Presentation, CPU, Interrupts, PPU, LCD, DMA, MBC, track_count };
+        static constexpr uint8_t first_emulated_track = CPU;
+
+        Timeline(std::string timeline_file, ::CPU* cpu); // the CPU's cycle count is the emulated clock
+        ~Timeline();
+
+        // names must be string literals (only the pointer is stored). arg < 0 means no argument
+        void instant(Track track, const char* name, int32_t arg = -1) { add_(track, 'i', name, now_(track), 0, arg); };
+        void span(Track track, const char* name, uint64_t start, uint64_t end, int32_t arg = -1) { add_(track, 'X', name, start, end - start, arg); };
+        void state(Track track, const char* name); // end the track's current state span (if any) and start a new one, unless it is the same (nullptr for none)
+
+        uint64_t now(Track track) { return now_(track); }; // in the track's time: host nanoseconds or emulated cycles
+
+    private:
+        struct Event {
+            uint64_t time;
+            uint64_t duration;
+            const char* name;
+            int32_t arg;
+            Track track;
+            char phase;
+        };
+        static constexpr size_t chunk_size = 16384; // events
+        static constexpr size_t chunk_count = 8;
+        using Chunk = std::vector<Event>;
+
+        uint64_t now_(Track track);
+        static int producer_(Track track) { return track == Presentation ? 1 : 0; }; // the thread recording the track
+        void add_(Track track, char phase, const char* name, uint64_t time, uint64_t duration, int32_t arg)
+        {
+            Chunk*& current = current_[producer_(track)];
+            if (current->size() == chunk_size && !next_chunk_(current)) {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            current->push_back({time, duration, name, arg, track, phase});
+        };
+        bool next_chunk_(Chunk*& current); // hand the full chunk to the writer and take an empty one
+        void write_events(); // writer thread
+
+        ::CPU* cpu_;
+        std::chrono::steady_clock::time_point host_start_;
+        std::array<const char*, track_count> state_name_ {};
+        std::array<uint64_t, track_count> state_start_ {};
+
+        std::vector<Chunk> chunks_;
+        std::array<Chunk*, 2> current_; // the chunk each producer is filling
+        std::vector<Chunk*> free_chunks_;
+        std::vector<Chunk*> full_chunks_;
+        std::mutex mutex_; // guards the chunk lists
+        std::condition_variable full_;
+        bool stop_ = false;
+        std::atomic<uint64_t> dropped_ = 0;
+
+        std::ofstream timeline_writer_;
+        std::thread writer_thread_;
+};
+
+#endif
\ No newline at end of file
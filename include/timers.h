@@ -2,14 +2,20 @@
 #define TIMERS_H
 
 #include <cstdint>
-
-class Bus;
+#include "interrupts.h"
 
 class Timers
 {
     public:
         void increment_cycle_counter();
-        void connect_bus(Bus* bus);
+        uint32_t idle_cycles(); // how many of the next cycles only advance DIV (without incrementing TIMA)
+        void skip(uint32_t cycles); // let up to idle_cycles() cycles pass at once
+        // how many of the next cycles do not change TIMA (nor the upper byte of DIV, the part the CPU reads, if div), and how many of
+        // the last cycles did not
+        uint32_t steady_cycles(bool div);
+        uint32_t quiet_cycles(bool div);
+        bool div_read_within(uint32_t cycles) { return static_cast<uint32_t>(t_cycle_counter) - div_read_at_ <= cycles; }; // was DIV read in the last cycles
+        void connect_interrupts(InterruptController* interrupts);
 
         void write(uint16_t address, uint8_t value);
         void write_div(); // writing any value to this register resets it to 0
@@ -25,14 +31,16 @@ class Timers
         uint8_t read_tac();
 
     private:
-        Bus* bus_; // connect to Bus to request timer interrupts
+        InterruptController* interrupts_; // to request timer interrupts
         int t_cycle_counter = 0; // count t cycles so that we can update the div register and tima registers based on M cycle count
 
         uint16_t div_ = 0x0; // the actual DIV register is only the top 8 bits of the system clock
+        uint32_t div_read_at_ = 0; // t_cycle_counter at the last read of DIV
         uint8_t tima_ = 0x0;
         uint8_t tma_ = 0x0;
         uint8_t tac_ = 0x0;
 
+        uint8_t selected_div_bit(); // the DIV bit whose falling edge increments TIMA, for the clock selected in TAC
         uint8_t prev_cycle_AND_result = 0;
         uint8_t tima_overflow_count = 0;
 };
@@ -0,0 +1,41 @@
+/*
+trace_file.h: header file for trace_file.cpp
+
+Read-only access to a binary trace file (see trace_format.h) written by the Tracer. The file is memory mapped, so
+multi-gigabyte traces can be opened instantly and records are only paged in when they are looked at.
+*/
+
+#ifndef TRACE_FILE_H
+#define TRACE_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "trace_format.h"
+
+class TraceFile {
+    public:
+        TraceFile(std::string trace_file);
+        ~TraceFile();
+
+        uint64_t size() const { return record_count_; };
+        const TraceRecord& operator[](uint64_t record) const { return records_[record]; };
+        uint64_t find_cycle(uint64_t cycle) const; // first record fetched at or after the given cycle (size() if there is none)
+
+    private:
+        void* map_ = nullptr;
+        size_t map_size_ = 0;
+
+        const TraceRecord* records_ = nullptr;
+        uint64_t record_count_ = 0;
+        const TraceIndexEntry* index_ = nullptr; // nullptr if the trace was not closed properly
+        uint64_t index_entries_ = 0;
+};
+
+// write a record as a gameboy-doctor log line ("A:01 F:B0 ... PCMEM:00,C3,13,02"), without the newline.
+// out must have room for format_doctor_line_length characters. Returns the number of characters written
+constexpr size_t format_doctor_line_length = 73;
+size_t format_doctor_line(const TraceRecord& record, char* out);
+
+#endif
@@ -0,0 +1,55 @@
+/*
+trace_format.h: layout of the binary CPU trace files written by the Tracer
+
+    TraceHeader
+    TraceRecord[record_count]          one fixed-size record per executed instruction
+    TraceIndexEntry[index_entries]     cycle of every trace_index_interval'th record
+    TraceTrailer
+
+The index and trailer are written when the trace is closed. A trace cut short (e.g. by a crash) has no trailer; its
+records are still valid, and since cycles only increase, readers can binary search the records themselves instead.
+*/
+
+#ifndef TRACE_FORMAT_H
+#define TRACE_FORMAT_H
+
+#include <cstdint>
+
+constexpr char trace_magic[8] = {'G', 'B', 'T', 'R', 'A', 'C', 'E', '1'};
+constexpr char trace_index_magic[8] = {'G', 'B', 'T', 'R', 'I', 'D', 'X', '1'};
+constexpr uint64_t trace_index_interval = 4096;
+
+struct TraceHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+};
+
+struct TraceRecord {
+    uint64_t cycle; // master clock cycle at which the instruction was fetched
+    uint16_t pc;
+    uint16_t sp;
+    uint16_t af;
+    uint16_t bc;
+    uint16_t de;
+    uint16_t hl;
+    uint8_t opcode[4]; // memory at pc .. pc + 3
+};
+
+struct TraceIndexEntry {
+    uint64_t cycle;
+    uint64_t record;
+};
+
+struct TraceTrailer {
+    uint64_t index_offset; // file offset of the first TraceIndexEntry
+    uint64_t index_entries;
+    uint64_t record_count;
+    char magic[8];
+};
+
+static_assert(sizeof(TraceHeader) == 16);
+static_assert(sizeof(TraceRecord) == 24);
+static_assert(sizeof(TraceTrailer) == 32);
+
+#endif
@@ -0,0 +1,61 @@
+/*
+tracer.h: header file for tracer.cpp
+
+The Tracer records every executed instruction as a fixed-size binary TraceRecord (see trace_format.h). The CPU
+only copies the record into a lock-free single producer / single consumer ring; a writer thread drains the ring
+into the trace file, so tracing minutes of gameplay at full speed is possible. The CPU hook is only compiled in
+when GB_TRACE is defined (cmake -DGAMEBOY_TRACE=ON).
+
+Constructor: open the trace file and start the writer thread. Destructor: drain the ring, then write the index.
+*/
+
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "trace_format.h"
+
+class Tracer {
+    public:
+        Tracer(std::string trace_file); // throws std::runtime_error if the file cannot be opened
+        ~Tracer();
+
+        void record(const TraceRecord& record)
+        {
+            // called for every instruction on the emulation thread: no locks and no system calls
+            uint64_t head = head_.load(std::memory_order_relaxed);
+            while (head - cached_tail_ >= ring_size) {
+                // the ring is full, wait for the writer (records are never dropped)
+                cached_tail_ = tail_.load(std::memory_order_acquire);
+                if (head - cached_tail_ >= ring_size) {
+                    std::this_thread::yield();
+                }
+            }
+            ring_[head & (ring_size - 1)] = record;
+            head_.store(head + 1, std::memory_order_release);
+        };
+
+    private:
+        void write_records(); // writer thread: drain the ring into the trace file
+
+        static constexpr uint64_t ring_size = 1 << 16; // records, must be a power of two
+        std::unique_ptr<TraceRecord[]> ring_;
+
+        alignas(64) std::atomic<uint64_t> head_ = 0; // next record written by the CPU
+        uint64_t cached_tail_ = 0; // the CPU's last view of tail_, so it only reads the shared counter when the ring looks full
+        alignas(64) std::atomic<uint64_t> tail_ = 0; // next record to be written to the file
+        std::atomic<bool> stop_ = false;
+
+        std::ofstream trace_writer_;
+        std::vector<TraceIndexEntry> index_;
+        std::thread writer_thread_;
+};
+
+#endif
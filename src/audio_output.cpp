@@ -0,0 +1,88 @@
+#include "audio_output.h"
+#include <algorithm>
+#include <iostream>
+
+AudioOutput::AudioOutput(int sample_rate)
+{
+    sample_rate_ = sample_rate;
+    if (SDL_InitSubSystem(SDL_INIT_AUDIO) != 0) {
+        std::cout << "Warning: no audio: " << SDL_GetError() << std::endl;
+        return;
+    }
+
+    // a short device buffer, so the ring holds most of the latency and its level says how far ahead the emulation is
+    SDL_AudioSpec wanted {};
+    wanted.freq = sample_rate;
+    wanted.format = AUDIO_S16SYS;
+    wanted.channels = 2;
+    wanted.samples = 256;
+    wanted.callback = callback_;
+    wanted.userdata = this;
+    SDL_AudioSpec obtained {};
+    device_ = SDL_OpenAudioDevice(nullptr, 0, &wanted, &obtained, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE);
+    if (device_ == 0) {
+        std::cout << "Warning: could not open an audio device: " << SDL_GetError() << std::endl;
+        return;
+    }
+    sample_rate_ = obtained.freq;
+    set_latency(latency_);
+}
+
+AudioOutput::~AudioOutput()
+{
+    if (device_ != 0) {
+        SDL_CloseAudioDevice(device_);
+    }
+    SDL_QuitSubSystem(SDL_INIT_AUDIO);
+}
+
+void AudioOutput::set_latency(double seconds)
+{
+    latency_ = std::clamp(seconds, 0.01, 0.2);
+    target_ = std::min(static_cast<size_t>(latency_ * sample_rate_), ring_.capacity() / 2);
+}
+
+void AudioOutput::queue(const int16_t* samples, size_t count)
+{
+    if (device_ != 0) {
+        // if the ring is full (the audio thread stalled), the rest of the frame is dropped
+        ring_.write(samples, count);
+        if (!started_ && ring_.size() >= target_) {
+            // start playing once the ring is at the target, rather than filling it up with underruns
+            SDL_PauseAudioDevice(device_, 0);
+            started_ = true;
+        }
+    }
+}
+
+double AudioOutput::rate_adjustment()
+{
+    /* Called once per frame. A steady difference between the two clocks (e.g. 60 Hz vs 59.7275 Hz) is learned slowly into
+    drift_, and what is left of the error moves the rate in proportion: the level jitters by up to a device buffer from
+    frame to frame, which only moves the rate by a fraction of max_rate_deviation */
+    if (device_ == 0) {
+        return 1;
+    }
+    double error = std::clamp((static_cast<double>(target_) - ring_.size()) / target_, -1.0, 1.0);
+    drift_ = std::clamp(drift_ + drift_rate * error, -max_drift, max_drift);
+    return 1 + drift_ + max_rate_deviation * error;
+}
+
+void AudioOutput::callback_(void* userdata, Uint8* stream, int length)
+{
+    AudioOutput* output = static_cast<AudioOutput*>(userdata);
+    int16_t* samples = reinterpret_cast<int16_t*>(stream);
+    size_t count = length / (2 * sizeof(int16_t));
+
+    size_t read = output->ring_.read(samples, count);
+    if (read > 0) {
+        output->last_ = {samples[2 * read - 2], samples[2 * read - 1]};
+    }
+    if (read < count) {
+        output->underruns_.fetch_add(1, std::memory_order_relaxed);
+        for (size_t sample = read; sample < count; sample++) {
+            samples[2 * sample] = output->last_[0];
+            samples[2 * sample + 1] = output->last_[1];
+        }
+    }
+}
@@ -0,0 +1,45 @@
+#include "audio_ring.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+AudioRing::AudioRing(size_t capacity)
+{
+    capacity = std::bit_ceil(capacity);
+    buffer_.resize(2 * capacity);
+    mask_ = capacity - 1;
+}
+
+size_t AudioRing::write(const int16_t* samples, size_t count)
+{
+    size_t write_index = write_index_.load(std::memory_order_relaxed);
+    size_t read_index = read_index_.load(std::memory_order_acquire);
+    count = std::min(count, capacity() - (write_index - read_index));
+
+    // the indices only ever grow: the part up to the end of the buffer, then the part wrapping around to the start
+    size_t start = write_index & mask_;
+    size_t first = std::min(count, capacity() - start);
+    std::memcpy(&buffer_[2 * start], samples, first * 2 * sizeof(int16_t));
+    std::memcpy(&buffer_[0], samples + 2 * first, (count - first) * 2 * sizeof(int16_t));
+    write_index_.store(write_index + count, std::memory_order_release);
+    return count;
+}
+
+size_t AudioRing::read(int16_t* samples, size_t count)
+{
+    size_t read_index = read_index_.load(std::memory_order_relaxed);
+    size_t write_index = write_index_.load(std::memory_order_acquire);
+    count = std::min(count, write_index - read_index);
+
+    size_t start = read_index & mask_;
+    size_t first = std::min(count, capacity() - start);
+    std::memcpy(samples, &buffer_[2 * start], first * 2 * sizeof(int16_t));
+    std::memcpy(samples + 2 * first, &buffer_[0], (count - first) * 2 * sizeof(int16_t));
+    read_index_.store(read_index + count, std::memory_order_release);
+    return count;
+}
+
+size_t AudioRing::size()
+{
+    return write_index_.load(std::memory_order_acquire) - read_index_.load(std::memory_order_acquire);
+}
@@ -2,6 +2,7 @@
 #include <iostream>
 #include <cstdint>
 #include <fstream>
+#include <stdexcept>
 #include <string>
 
 BootROM::BootROM() 
@@ -17,8 +18,7 @@ void BootROM::load_bootrom_file(std::string bootrom_file)
 
     if (!bootrom_reader) {
         // error opening the bootrom file
-        std::cout << "Error: could not open the provided bootrom file." << std::endl;
-        exit(-1);
+        throw std::runtime_error("could not open the boot ROM file " + bootrom_file + ".");
     }
 
     // successfully opened file, read stream of bytes into the bootrom array
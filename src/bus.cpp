@@ -4,6 +4,7 @@
 #include "joypad.h"
 #include "serial.h"
 #include "timers.h"
+#include "timeline.h"
 #include <SDL_events.h>
 #include <cstdint>
 #include <SDL.h>
@@ -12,7 +13,7 @@
 #include <ram.h>
 #include <ppu.h>
 
-Bus::Bus(CPU* cpu, RAM* ram, PPU* ppu, BootROM* bootrom, Cartridge* cartridge, Serial* serial, Timers* timers, Joypad* joypad) 
+Bus::Bus(CPU* cpu, RAM* ram, PPU* ppu, BootROM* bootrom, Cartridge* cartridge, Serial* serial, Timers* timers, Joypad* joypad, Sound* sound, InterruptController* interrupts) 
 {
     // link the bus to all of the hardware components created in the GameBoy class
     cpu_ = cpu;
@@ -23,9 +24,43 @@ Bus::Bus(CPU* cpu, RAM* ram, PPU* ppu, BootROM* bootrom, Cartridge* cartridge, S
     serial_ = serial;
     timers_ = timers;
     joypad_ = joypad;
+    sound_ = sound;
+    interrupts_ = interrupts;
 }
 
 uint8_t Bus::read(uint16_t address)
+{
+#ifdef GB_STATS
+    stats_.read(address);
+#endif
+    return (this->*read_)(address);
+}
+
+bool Bus::dma_blocks_(uint16_t address)
+{
+    /* The memory map while an OAM DMA transfer is scheduled: the CPU can only reach the I/O registers and HRAM until it
+    ends. Its first access after that completes the transfer, and puts the normal map back */
+    if (ppu_->finish_oam_dma()) {
+        read_ = &Bus::read_mapped_;
+        write_ = &Bus::write_mapped_;
+        return false;
+    }
+    return address < 0xff00 && ppu_->oam_dma_blocks(cpu_->cycle_count());
+}
+
+uint8_t Bus::read_during_dma_(uint16_t address)
+{
+    return dma_blocks_(address) ? 0xff : read_mapped_(address);
+}
+
+void Bus::write_during_dma_(uint16_t address, uint8_t value)
+{
+    if (!dma_blocks_(address)) {
+        write_mapped_(address, value);
+    }
+}
+
+uint8_t Bus::read_mapped_(uint16_t address)
 {
     if (address >= 0x0000 && address < 0x0100) {
         // read from the boot ROM (no corresponding write, since this is ROM) 
@@ -78,24 +113,105 @@ uint8_t Bus::read(uint16_t address)
     }
     else if (address == 0xff0f) {
         // read the interrupt flag
-        return cpu_->read_if();
+        return interrupts_->read_if();
+    }
+    else if (address >= 0xff10 && address <= 0xff3f) {
+        // sound registers and wave RAM: the APU catches up to the CPU first
+        return sound_->read(address, cpu_->cycle_count());
     }
     else if (address >= 0xff80 && address <= 0xfffe) {
         return cpu_->read_hram(address);
     }
     else if (address == 0xffff) {
         // read the interrupt enable register
-        return cpu_->read_ie();
+        return interrupts_->read_ie();
     }
 
     return 0xff;
 }
 
+uint8_t Bus::peek(uint16_t address)
+{
+    /* Reading some I/O registers has side effects (or depends on state the debugger should not touch), so they are not
+    read by tracers and debuggers. Everything else reads as the CPU would see it */
+    if (address >= 0xff00 && address <= 0xff7f) {
+        return 0xff;
+    }
+    return read_mapped_(address);
+}
+
+const uint8_t* Bus::dma_source(uint8_t page)
+{
+    /* The boot ROM, the cartridge's ROM and RAM banks mapped now, and work RAM (VRAM is the PPU's own) */
+    if (page == 0x00 && !bootrom_->read_bank()) {
+        return bootrom_->data();
+    }
+    if (page <= 0x7f || (page >= 0xa0 && page <= 0xbf)) {
+        return cartridge_->dma_source(page);
+    }
+    if (page >= 0xc0 && page <= 0xdf) {
+        return &ram_->ram_[(page - 0xc0) * 0x100];
+    }
+    return nullptr;
+}
+
+void Bus::record_write_(uint16_t address, uint8_t value)
+{
+    /* Record writes to the LCD / interrupt registers. Bank switches are recorded by write, once the MBC has handled them */
+    switch (address) {
+        case 0xff0f:
+            {
+                // every newly set bit is an interrupt request
+                uint8_t requested = value & ~interrupts_->read_if() & 0x1f;
+                for (int bit = 0; bit < 5; bit++) {
+                    if (requested & (1 << bit)) {
+                        timeline_->instant(Timeline::Interrupts, InterruptController::names[bit]);
+                    }
+                }
+            }
+            break;
+        case 0xff40:
+            timeline_->instant(Timeline::LCD, "LCDC", value);
+            break;
+        case 0xff41:
+            timeline_->instant(Timeline::LCD, "STAT", value);
+            break;
+        case 0xff46:
+            {
+                // the transfer takes 160 m-cycles
+                uint64_t start = timeline_->now(Timeline::DMA);
+                timeline_->span(Timeline::DMA, "OAM DMA", start, start + 640, value << 8);
+            }
+            break;
+    }
+}
+
 void Bus::write(uint16_t address, uint8_t value) 
 {
-    if (address >= 0x0000 && address <= 0x7fff) {
+#ifdef GB_STATS
+    stats_.write(address);
+#endif
+    if (timeline_) {
+        record_write_(address, value);
+    }
+    (this->*write_)(address, value);
+}
+
+void Bus::write_mapped_(uint16_t address, uint8_t value)
+{
+    if (address == 0xff46) {
+        // the PPU schedules the transfer against the CPU's clock, and the bus is cut off until it ends
+        ppu_->start_oam_dma(value, cpu_->cycle_count());
+        read_ = &Bus::read_during_dma_;
+        write_ = &Bus::write_during_dma_;
+    }
+    else if (address >= 0x0000 && address <= 0x7fff) {
         // access to MBC external RAM + MBC registers 
+        uint16_t rom_bank = cartridge_->rom_bank();
         cartridge_->write(address, value);
+        if (timeline_ && cartridge_->rom_bank() != rom_bank) {
+            timeline_->instant(Timeline::MBC, "ROM bank", cartridge_->rom_bank());
+        }
     }
     else if ((address >= 0x8000 && address <= 0x9fff) || (address >= 0xff40 && address <= 0xff4b) || (address >= 0xfe00 && address <= 0xfe9f)) {
         // write to VRAM (first range) OR to LCD registers (second range) OR to OAM (third range)
@@ -124,7 +240,10 @@ void Bus::write(uint16_t address, uint8_t value)
     }
     else if (address == 0xff0f) {
         // update the interrupt flag register (make a request for an interrupt)
-        cpu_->write_if(value);
+        interrupts_->write_if(value);
+    }
+    else if (address >= 0xff10 && address <= 0xff3f) {
+        sound_->write(address, value, cpu_->cycle_count());
     }
     else if (address == 0xff50) {
         bootrom_->write_bank(value);
@@ -134,6 +253,6 @@ void Bus::write(uint16_t address, uint8_t value)
     }
     else if (address == 0xffff) {
         // update the interrupt enable register
-        cpu_->write_ie(value);
+        interrupts_->write_ie(value);
     }
 }
\ No newline at end of file
@@ -2,21 +2,24 @@
 #include "mbc/mbc1.h"
 #include "mbc/mbc3.h"
 #include <cstdint>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <sstream>
+#include <stdexcept>
 #include <string>
 
-void Cartridge::load_cartridge_from_file(std::string cartridge_file)
+void Cartridge::load_cartridge_from_file(std::string cartridge_file, bool persistent_saves)
 {
-    /* Read the Cartridge from the specified .gb file,  */
+    /* Read the Cartridge from the specified .gb file. A file that cannot be loaded throws std::runtime_error, so a tool
+    running many ROMs can report it and go on with the others */
     std::ifstream cartridge_reader;
     cartridge_reader.open(cartridge_file, std::ios::binary); // open as a binary file, cartridge given as .bin
 
     if (!cartridge_reader) {
         // error opening the cartridge file
-        std::cout << "Error: could not open the provided cartridge file." << std::endl;
-        exit(-1);
+        throw std::runtime_error("could not open the cartridge file " + cartridge_file + ".");
     }
 
     // successfully opened file, read stream of bytes into the cartridge array
@@ -30,13 +33,23 @@ void Cartridge::load_cartridge_from_file(std::string cartridge_file)
     cartridge_reader.close();
 
     // to be a valid cartridge, the number of bytes must be divisible by the bank size, 16KB
-    if (cartridge_.size() % (16 * 1024) != 0) {
-        std::cout << "Error: invalid cartridge size." << std::endl;
-        exit(-1);
+    if (cartridge_.empty() || cartridge_.size() % (16 * 1024) != 0) {
+        throw std::runtime_error("invalid cartridge size (" + std::to_string(cartridge_.size()) + " bytes).");
     }
 
     // read any required information from the cartridge header
     mbc_header_val_ = cartridge_[0x0147]; // mbc mode found in catridge header. 0x0147 contains the cartridge type, and indicates how the Cartridge is organized
+    if (!mbc_code_to_name_.contains(mbc_header_val_)) {
+        std::stringstream message;
+        message << "unsupported cartridge type 0x" << std::hex << static_cast<int>(mbc_header_val_) << ".";
+        throw std::runtime_error(message.str());
+    }
+
+    // battery-backed RAM is kept in <rom name>.sav (see save_ram.h)
+    std::string save_file;
+    if (persistent_saves && (mbc_header_val_ == 0x03 || mbc_header_val_ == 0x0f || mbc_header_val_ == 0x10 || mbc_header_val_ == 0x13)) {
+        save_file = std::filesystem::path(cartridge_file).replace_extension(".sav").string();
+    }
 
     // create the appropriate MBC chip for the cartridge
     switch (mbc_header_val_) {
@@ -44,15 +57,28 @@ void Cartridge::load_cartridge_from_file(std::string cartridge_file)
             // no mbc chip
             break;
         case 0x1:
+        case 0x2:
+        case 0x3:
             // mbc1 chip
-            mbc_ = std::make_unique<MBC1>(cartridge_);
+            mbc_ = std::make_unique<MBC1>(cartridge_, save_file);
             break;
+        case 0x0f:
+        case 0x10:
+            // mbc3 chip with a real-time clock
+            mbc_ = std::make_unique<MBC3>(cartridge_, save_file, true);
+            break;
+        case 0x11:
+        case 0x12:
         case 0x13:
-            mbc_ = std::make_unique<MBC3>(cartridge_);
+            mbc_ = std::make_unique<MBC3>(cartridge_, save_file);
+            break;
         default:
             break;
     }
+}
 
+void Cartridge::print_info()
+{
     std::cout << "Cartridge Type: " << mbc_code_to_name_.at(mbc_header_val_) << '\n'; 
     if (mbc_header_val_ == 0) {
         std::cout << "Cartridge size (bytes): " << cartridge_.size() << std::endl;
@@ -67,7 +93,8 @@ uint8_t Cartridge::read(uint16_t address)
 {
     // if there is no MBC, then there is no swapping of banks. We can read directly from the 32 KiB ROM
     if (mbc_header_val_ == 0x0) {
-        return cartridge_[address];
+        // and no RAM
+        return address <= 0x7fff ? cartridge_[address] : 0xff;
     }
     else {
         // we have an mbc, read from it
@@ -75,6 +102,15 @@ uint8_t Cartridge::read(uint16_t address)
     }
 }
 
+const uint8_t* Cartridge::dma_source(uint8_t page)
+{
+    uint16_t address = page << 8;
+    if (mbc_header_val_ == 0x0) {
+        return address <= 0x7fff ? &cartridge_[address] : nullptr;
+    }
+    return mbc_->memory(address);
+}
+
 void Cartridge::write(uint16_t address, uint8_t value)
 {
     /* Write to the MBC registers or external RAM */
@@ -1,7 +1,14 @@
 #include <cpu.h>
 #include <bus.h>
 #include <cstdint>
-#include <iomanip>
+#ifdef GB_TRACE
+#include <tracer.h>
+#endif
+#ifdef GB_PROFILE
+#include <profiler.h>
+#endif
+#include <timeline.h>
+#include <bit>
 #include <sys/wait.h>
 #include <unistd.h>
 
@@ -153,33 +160,37 @@ CPU::CPU()
 
 CPU::~CPU()
 {
-    log_file.close();
-}
-
-void CPU::cpu_log_()
-{
-    int a = (af_ & 0xff00) >> 8;
-    int f = (af_ & 0xff);
-    int b = (bc_ & 0xff00) >> 8;
-    int c = (bc_ & 0xff);
-    int d = (de_ & 0xff00) >> 8;
-    int e = (de_ & 0xff);
-    int h = (hl_ & 0xff00) >> 8;
-    int l = (hl_ & 0xff);
-    log_file << "A:" << std::setfill('0') << std::setw(2) << std::hex << a ;
-    log_file << " F:" << std::setfill('0') << std::setw(2) << std::hex << f ;
-    log_file << " B:" << std::setfill('0') << std::setw(2)<< std::hex << b ;
-    log_file << " C:"<< std::setfill('0') << std::setw(2) << std::hex << c ;
-    log_file << " D:" << std::setfill('0') << std::setw(2)<< std::hex << d ;
-    log_file << " E:" << std::setfill('0') << std::setw(2)<< std::hex << e ;
-    log_file << " H:" << std::setfill('0') << std::setw(2)<< std::hex << h ;
-    log_file << " L:" << std::setfill('0') << std::setw(2)<< std::hex << l ;
-    log_file << " SP:" << std::setfill('0') << std::setw(4) << std::hex << sp_ ;
-    log_file << " PC:" << std::setfill('0') << std::setw(4) << std::hex << pc_;
-    log_file << " PCMEM:" << std::setfill('0') << std::setw(2) << std::hex << (int)read(pc_) << ",";
-    log_file << std::setfill('0') << std::setw(2) << std::hex << (int)read(pc_ + 1) << ",";
-    log_file << std::setfill('0') << std::setw(2) << std::hex << (int)read(pc_ + 2) << ",";
-    log_file << std::setfill('0') << std::setw(2) << std::hex << (int)read(pc_ + 3) << "\n";
+}
+
+#ifdef GB_TRACE
+void CPU::trace_()
+{
+    /* Record the registers and the bytes at the pc before the instruction executes (the gameboy-doctor log line) */
+    TraceRecord record;
+    record.cycle = t_cycles_elapsed_;
+    record.pc = pc_; record.sp = sp_;
+    record.af = af_; record.bc = bc_; record.de = de_; record.hl = hl_;
+    for (int i = 0; i < 4; i++) {
+        record.opcode[i] = bus_->peek(pc_ + i);
+    }
+    tracer_->record(record);
+}
+#endif
+
+CPU::Registers CPU::get_registers()
+{
+    return {af_, bc_, de_, hl_, sp_, pc_};
+}
+
+void CPU::skip_bootrom()
+{
+    /* Set the registers to the state the DMG boot ROM leaves them in when it hands control to the cartridge */
+    af_ = 0x01b0;
+    bc_ = 0x0013;
+    de_ = 0x00d8;
+    hl_ = 0x014d;
+    sp_ = 0xfffe;
+    pc_ = 0x0100;
 }
 
 void CPU::connect_bus(Bus* bus)
@@ -188,40 +199,97 @@ void CPU::connect_bus(Bus* bus)
     bus_ = bus;
 }
 
-void CPU::call_handler(interrupts interrupt, uint8_t handler_location) // call the respective handler for interrupt
+void CPU::connect_interrupts(InterruptController* interrupts)
 {
-        ime_ = false; // disabled IME to prevent any further interrupts until program reenables them
-        // clear the flag in IF to acknoledge the interrupt, using xor to toggle bit
-        if_ ^= interrupt;
+    interrupts_ = interrupts;
+}
+
+void CPU::call_handler(int interrupt) // call the respective handler for interrupt
+{
+        interrupts_->set_ime(false); // disabled IME to prevent any further interrupts until program reenables them
+        // clear the flag in IF to acknoledge the interrupt
+        interrupts_->acknowledge(interrupt);
+        uint8_t handler_location = 0x40 + 8 * interrupt;
 
         // save the pc on the stack
         write(--sp_, (pc_ & 0xff00) >> 8);
         write(--sp_, pc_ & 0xff);
 
+#ifdef GB_PROFILE
+        if (profiler_) {
+            profiler_->interrupt(pc_, handler_location, sp_);
+        }
+#endif
+
+#ifdef GB_STATS
+        bus_->stats().interrupts[interrupt]++;
+#endif
+        idle_loop_.not_idle();
+
         // call the handler
         pc_ = handler_location;
 
         t_cycles_delay += 20;  // switching control to handler takes 20 cycles
+
+        if (Timeline* timeline = bus_->timeline()) {
+            static const char* dispatch_names[] = {"VBlank handler", "LCD handler", "Timer handler", "Serial handler", "Joypad handler"};
+            uint64_t now = timeline->now(Timeline::CPU);
+            timeline->span(Timeline::CPU, dispatch_names[interrupt], now, now + 20);
+        }
+}
+
+void CPU::skip_halted(uint32_t cycles)
+{
+    /* Only valid while halted(): the same as calling cycle() this many times, none of which would wake the CPU */
+    t_cycles_elapsed_ += cycles;
+    t_cycles_delay = cycles >= t_cycles_delay ? 0 : t_cycles_delay - cycles;
+}
+
+uint32_t CPU::check_idle_loop_()
+{
+    uint32_t cycles = idle_loop_.repeating_cycles();
+#ifdef GB_TRACE
+    if (tracer_) {
+        return 0; // every instruction has to be traced
+    }
+#endif
+#ifdef GB_PROFILE
+    if (profiler_) {
+        return 0;
+    }
+#endif
+    // an interrupt requested on this cycle would be taken before the next iteration
+    if (interrupts_->ready()) {
+        return 0;
+    }
+    return cycles;
+}
+
+void CPU::skip_idle_loop(uint32_t iterations)
+{
+    /* the CPU ends up where it is now, at the same point of the loop, with the same registers */
+    t_cycles_elapsed_ += static_cast<uint64_t>(iterations) * idle_loop_.cycles();
+    instructions_elapsed_ += idle_loop_.skip(iterations);
 }
 
 void CPU::handle_interrupts() 
 {
     /* Calls the appropriate interrupt handler based on the contents of IE and IF. Disables the IME before executing the handler. */
-    // list of interrupt handlers sorted by their priority (following order of bits, with bit 0 having highest priority)
-    // it is possible for multiple bits to be set, so handle the highest priority first 
-    if ((if_ & CPU::interrupts::VBlank) && (ie_ & CPU::interrupts::VBlank)) { call_handler(CPU::interrupts::VBlank, 0x40); } 
-    else if ((if_ & CPU::interrupts::LCD) && (ie_ & CPU::interrupts::LCD)) { call_handler(CPU::interrupts::LCD, 0x48); }
-    else if ((if_ & CPU::interrupts::Timer) && (ie_ & CPU::interrupts::Timer)) { call_handler(CPU::interrupts::Timer, 0x50); }
-    else if ((if_ & CPU::interrupts::Serial) && (ie_ & CPU::interrupts::Serial)) { call_handler(CPU::interrupts::Serial, 0x58); }
-    else if ((if_ & CPU::interrupts::Joypad) && (ie_ & CPU::interrupts::Joypad)) { call_handler(CPU::interrupts::Joypad, 0x60); }
+    // it is possible for multiple bits to be set, so handle the highest priority first (bit 0 has the highest priority)
+    call_handler(interrupts_->highest());
 }
 
 void CPU::cycle()
 {
     /* Perform one cycle of the CPU */
+    t_cycles_elapsed_++;
 
     //-- INTERRUPT HANDLING --
-    if ((ie_ & if_) != 0) {
+    // the controller keeps the requested and enabled interrupts as a mask, so there is only something to do when it is set
+    if (interrupts_->pending()) {
+        if (halt_mode && bus_->timeline()) {
+            bus_->timeline()->state(Timeline::CPU, nullptr);
+        }
         halt_mode = false;
     }
 
@@ -237,7 +305,7 @@ void CPU::cycle()
 
     // if there was an interrupt pending, we have now exited halt mode, and if IME is set, handle the interrupt. Also check that t_cycles_delay is 0,
     // to check in case the last interrupt handler has finished running 
-    if ((ime_ == 1) && (t_cycles_delay == 0)) {
+    if (interrupts_->ready() && (t_cycles_delay == 0)) {
         handle_interrupts();
     }
 
@@ -245,11 +313,30 @@ void CPU::cycle()
     // perform a cycle if we have the ability to (if we have the ability to - the last instruction has completed)
     if (t_cycles_delay == 0) {
 
-        if (log) {
-            cpu_log_();
+#ifdef GB_TRACE
+        if (tracer_) {
+            trace_();
+        }
+#endif
+
+        // the start of a busy-wait loop ends its last iteration (see idle_loop.h)
+        uint16_t instruction_pc = pc_;
+        if (idle_loop_.at_start(pc_)) {
+            idle_loop_.iteration({af_, bc_, de_, hl_, sp_, interrupts_->ime()}, t_cycles_elapsed_, instructions_elapsed_);
         }
 
         uint8_t instruction_code = read(pc_);
+        instructions_elapsed_++;
+#ifdef GB_PROFILE
+        if (profiler_) {
+            profiler_->instruction(pc_, instruction_code, sp_, t_cycles_elapsed_);
+        }
+#endif
+#ifdef GB_STATS
+        // instructions are told apart by the bank they were fetched from, only the switchable bank 0x4000 - 0x7fff has one
+        uint32_t bank = (pc_ >= 0x4000 && pc_ <= 0x7fff) ? bus_->rom_bank() : 0;
+        bus_->stats().instruction((bank << 16) | pc_, instruction_code);
+#endif
 
         // the halt bug causes the same instruction to be executed again (the pc fails to increment)
         if (!halt_bug) {
@@ -262,7 +349,11 @@ void CPU::cycle()
         Instruction instruction;
         if (instruction_code == 0xcb) {
             // 16 bit instruction code, therefore we have to read another byte and then find the instruction in the 16 bit instruction table
-            instruction = cb_opcode_lookup[read(pc_)];
+            uint8_t cb_code = read(pc_);
+            instruction = cb_opcode_lookup[cb_code];
+#ifdef GB_STATS
+            bus_->stats().cb_opcodes[cb_code]++;
+#endif
             pc_++; // again increment the pc after reading another byte
         }
         else {
@@ -275,14 +366,29 @@ void CPU::cycle()
         // perform the instruction. if this is an instruction such as a CALL or RET or JP that requires extra cycles based on execuction, return this value
         // a member function must be called on an instance of the class, so we must explicitly say that we run the opcode_function based on this class
         uint8_t additional_cycles = (this->*instruction.opcode_function)();
-
+#ifdef GB_STATS
+        // conditional JR / JP / CALL / RET take longer when the branch is taken
+        switch (instruction_code) {
+            case 0x20: case 0x28: case 0x30: case 0x38:
+            case 0xc0: case 0xc8: case 0xd0: case 0xd8:
+            case 0xc2: case 0xca: case 0xd2: case 0xda:
+            case 0xc4: case 0xcc: case 0xd4: case 0xdc:
+                (additional_cycles > 0 ? bus_->stats().branches_taken : bus_->stats().branches_not_taken)[instruction_code]++;
+                break;
+        }
+#endif
 
         // get the final amount of cycles required to perform this instruction by getting the base cycles + additional cycles (for example, from conditional branches)
         t_cycles_delay += additional_cycles;
 
+        // a short backward jump may have closed a busy-wait loop
+        if (pc_ < instruction_pc) {
+            idle_loop_.branch(instruction_pc, pc_);
+        }
+
         // ei is delayed by 1 instruction, so now perform its behaviour if it was called. However, if DI was called, it switches off the delay and keeps ime false
         if (ei_delay) {
-            ime_ = true;
+            interrupts_->set_ime(true);
             ei_delay = false;
         }
     }
@@ -302,6 +408,9 @@ uint8_t CPU::read(uint16_t address)
 
 void CPU::write(uint16_t address, uint8_t value) 
 {
+    if (idle_loop_.tracking()) {
+        idle_loop_.write(address, value, bus_);
+    }
     bus_->write(address, value);
 }
 
@@ -315,22 +424,6 @@ void CPU::set_flag(CPU::flags flag, bool val)
     }
 }
 
-uint8_t CPU::read_ie()
-{
-    return ie_;
-}
-
-void CPU::write_ie(uint8_t value)
-{
-    ie_ = value;
-}
-
-
-uint8_t CPU::read_if()
-{
-    return if_;
-}
-
 uint8_t CPU::read_hram(uint16_t address)
 {
     return hram_[address - 0xff80];
@@ -342,11 +435,6 @@ void CPU::write_hram(uint16_t address, uint8_t value)
     hram_[address - 0xff80] = value;
 }
 
-void CPU::write_if(uint8_t value)
-{
-    if_ = value;
-}
-
 uint8_t CPU::read_flag(CPU::flags flag) 
 {
     switch (flag) {
@@ -765,7 +853,11 @@ uint8_t CPU::STOP_0()
 {
     pc_++; // stop considered to be a 2 byte instruction, so skip the next byte 
     stop_mode = true;
+    idle_loop_.not_idle();
 
+    if (Timeline* timeline = bus_->timeline()) {
+        timeline->instant(Timeline::CPU, "STOP");
+    }
     return 0;
 }
 
@@ -979,7 +1071,7 @@ void CPU::LOAD_CONTENTS_INTO_REG(uint16_t* reg_pair, bool top, uint8_t reg2_cont
     }
 }
 
-uint8_t CPU::LD_B_B() { LOAD_CONTENTS_INTO_REG(&bc_, 1, (bc_ & 0xff00) >> 8); return 0; }
+uint8_t CPU::LD_B_B() { LOAD_CONTENTS_INTO_REG(&bc_, 1, (bc_ & 0xff00) >> 8); breakpoint_hit_ = true; return 0; }
 uint8_t CPU::LD_B_C() { LOAD_CONTENTS_INTO_REG(&bc_, 1, (bc_ & 0xff)); return 0; }
 uint8_t CPU::LD_B_D() { LOAD_CONTENTS_INTO_REG(&bc_, 1, (de_ & 0xff00) >> 8); return 0; }
 uint8_t CPU::LD_B_E() { LOAD_CONTENTS_INTO_REG(&bc_, 1, (de_ & 0xff)); return 0; }
@@ -1037,20 +1129,24 @@ uint8_t CPU::LD_HL_m_L() { write(hl_, (hl_ & 0xff)); return 0; }
 uint8_t CPU::HALT() 
 {
     halt_mode = true;
+    idle_loop_.not_idle();
 
     // if an EI call immediately precedes this halt call, (and hence IME being 0), then call the interrupt handler (HALT bug different behaviour)
-    if (ei_delay && ime_ == 0 && ((ie_ & if_) != 0)) {
+    if (ei_delay && !interrupts_->ime() && interrupts_->pending()) {
         // handle the interrupt
         handle_interrupts();
         // keep halt mode ON, so that we now have to wait for another interrupt in the main CPU cycle. 
         return 20;
     }
-    else if ((ime_ == 0) && ((ie_ & if_) != 0)) {
+    else if (!interrupts_->ime() && interrupts_->pending()) {
         // conditions for the HALT bug, which will cause the PC to fail to increment
         halt_bug = true;
         halt_mode = false; // immediately end the HALT
     }
 
+    if (halt_mode && bus_->timeline()) {
+        bus_->timeline()->state(Timeline::CPU, "HALT");
+    }
     return 0;
 }
 
@@ -1532,7 +1628,8 @@ uint8_t CPU::RET_C()
 uint8_t CPU::RETI() 
 {
     /* enables interrupts and then returns */
-    ime_ = true;
+    interrupts_->set_ime(true);
+    idle_loop_.not_idle();
 
     uint8_t lower = read(sp_++);
     uint16_t upper = read(sp_++);
@@ -2009,7 +2106,7 @@ uint8_t CPU::LD_A_a16_m()
 uint8_t CPU::DI() 
 {
     /* disable IME and if EI was called, turn off signal to turn on IME after 1 instruction delay */
-    ime_ = false;
+    interrupts_->set_ime(false);
     ei_delay = false;
     return 0;
 }
@@ -2018,6 +2115,7 @@ uint8_t CPU::EI()
 {
     /* turn on signal to enable IME after a 1 instruction delay */
     ei_delay = true;
+    idle_loop_.not_idle(); // an interrupt could be taken part way through a later iteration
     return 0;
 }
 
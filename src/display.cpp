@@ -0,0 +1,85 @@
+#include <SDL2/SDL.h>
+#include <SDL_error.h>
+#include <SDL_hints.h>
+#include <SDL_pixels.h>
+#include <SDL_render.h>
+#include <SDL_video.h>
+#include <cstdint>
+#include <iostream>
+
+#include "display.h"
+
+// RGBA8888 colour for every shade the PPU writes into the framebuffer: near-white, light gray, dark gray, black,
+// and the plain white of a switched off LCD
+static constexpr std::array<uint32_t, 5> shade_to_rgba = {
+    0xf2f2f2ff, 0xbfbfbfff, 0x737373ff, 0x000000ff, 0xffffffff
+};
+
+Display::Display()
+{
+    // initialize SDL
+    if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+        std::cout << "Error: " << SDL_GetError();
+        exit(-1);
+    }
+
+    int scale = 4;
+    // create a window, renderer and texture
+    window_ = SDL_CreateWindow("GameBoy 1989", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, scale * SCREEN_WIDTH, scale * SCREEN_HEIGHT, SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE);
+    if (!window_) {
+        std::cout << "Failed to create window: " << SDL_GetError();
+        exit(-1);
+    }
+
+    SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "nearest");
+
+    renderer_ = SDL_CreateRenderer(window_, -1, SDL_RENDERER_ACCELERATED);
+    if (!renderer_) {
+        std::cout << "Failed to create renderer: " << SDL_GetError();
+        exit(-1);
+    }
+
+    // the whole frame is uploaded at once, so use a streaming texture instead of drawing points into a render target
+    texture_ = SDL_CreateTexture(renderer_, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, SCREEN_WIDTH, SCREEN_HEIGHT);
+    if (!texture_) {
+        std::cout << "Failed to create texture: " << SDL_GetError();
+    }
+
+    // initialize the texture to white
+    pixels_.fill(shade_to_rgba[4]);
+    SDL_UpdateTexture(texture_, NULL, pixels_.data(), SCREEN_WIDTH * sizeof(uint32_t));
+}
+
+Display::~Display()
+{
+    // destructor - exit out of SDL, and destroy all allocated resources
+    SDL_DestroyTexture(texture_);
+    SDL_DestroyRenderer(renderer_);
+    SDL_DestroyWindow(window_);
+    SDL_Quit();
+}
+
+void Display::set_title(const std::string& title)
+{
+    SDL_SetWindowTitle(window_, title.c_str());
+}
+
+void Display::render(const std::array<uint8_t, SCREEN_WIDTH * SCREEN_HEIGHT>& framebuffer)
+{
+    // convert the shades into colours, and upload the frame to the texture in one go
+    for (int i = 0; i < SCREEN_WIDTH * SCREEN_HEIGHT; i++) {
+        pixels_[i] = shade_to_rgba[framebuffer[i]];
+    }
+    SDL_UpdateTexture(texture_, NULL, pixels_.data(), SCREEN_WIDTH * sizeof(uint32_t));
+
+    // set the screen to black, and copy the texture to the screen
+    SDL_SetRenderDrawColor(renderer_, 0, 0, 0, SDL_ALPHA_OPAQUE);
+    SDL_RenderClear(renderer_);
+    SDL_RenderCopy(renderer_, texture_, NULL, NULL);
+}
+
+void Display::present()
+{
+    // update the window (this may wait for vsync)
+    SDL_RenderPresent(renderer_);
+}
@@ -0,0 +1,17 @@
+#include "frame_exchange.h"
+
+void FrameExchange::publish(uint64_t hash)
+{
+    hashes_[back_] = hash;
+    // release: the frame's pixels and hash are visible to the consumer before it can take the frame
+    back_ = middle_.exchange(static_cast<uint8_t>(back_ | fresh_bit), std::memory_order_acq_rel) & ~fresh_bit;
+}
+
+const FrameExchange::Frame& FrameExchange::take()
+{
+    if (fresh()) {
+        // acquire: see the pixels and hash of the frame published last
+        front_ = middle_.exchange(front_, std::memory_order_acq_rel) & ~fresh_bit;
+    }
+    return frames_[front_];
+}
\ No newline at end of file
@@ -4,22 +4,71 @@
 #include <SDL_events.h>
 #include <SDL_keycode.h>
 #include <SDL_video.h>
+#include <algorithm>
 #include <chrono>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+#include <thread>
+#ifdef GB_STATS
+#include <filesystem>
+#include <fstream>
+#endif
 #include <iostream>
 
-GameBoy::GameBoy(std::string bootrom_file, std::string cartridge_file) {
+GameBoy::GameBoy(std::string bootrom_file, std::string cartridge_file, bool headless) {
     /* set up hardware components of the Game Boy */
 
     // link hardware components
     cpu_.connect_bus(&bus_);
     ppu_.connect_bus(&bus_);
-    timers_.connect_bus(&bus_);
+    cpu_.connect_interrupts(&interrupts_);
+    ppu_.connect_interrupts(&interrupts_);
+    timers_.connect_interrupts(&interrupts_);
 
-    // load in the boot rom
-    bootrom_.load_bootrom_file(bootrom_file);
+    // load in the cartridge. Headless runs must be reproducible, so they neither load nor leave a save file
+    cartridge_.load_cartridge_from_file(cartridge_file, !headless);
+    // busy-wait loops of this ROM the idle loop heuristic misses (see idle_loop.h)
+    cpu_.set_idle_loop_overrides(IdleLoop::overrides_for(cartridge_.read(0x14d), (cartridge_.read(0x14e) << 8) | cartridge_.read(0x14f)));
 
-    // load in the cartridge
-    cartridge_.load_cartridge_from_file(cartridge_file);
+    if (!bootrom_file.empty()) {
+        // load in the boot rom
+        bootrom_.load_bootrom_file(bootrom_file);
+    }
+    else {
+        // no boot rom: recreate the state it leaves behind, and unmap it so the cartridge starts at 0x100
+        cpu_.skip_bootrom();
+        bus_.write(0xff40, 0x91); // LCD and background on, tile data at 0x8000
+        bus_.write(0xff47, 0xfc); // background palette
+        bus_.write(0xff26, 0x80); // NR52: sound on (the other registers ignore writes until it is)
+        bus_.write(0xff24, 0x77); // NR50: both outputs at full volume
+        bus_.write(0xff25, 0xf3); // NR51: all four channels on the left, channels 1 and 2 on the right
+        bus_.write(0xff50, 0x01);
+    }
+
+#ifdef GB_STATS
+    // the report goes next to the ROM, and leaves out the accesses made while setting up
+    stats_file_ = std::filesystem::path(cartridge_file).replace_extension(".stats.txt").string();
+    bus_.stats() = Stats();
+#endif
+
+    headless_ = headless;
+    if (headless) {
+        // runs without a window must not depend on when they were made
+        cartridge_.set_rtc_clock(&cpu_);
+        // nobody is watching the serial port output, the tool driving this GameBoy reads it instead
+        serial_.set_echo(false);
+        return;
+    }
+
+    display_ = std::make_unique<Display>();
+    audio_ = std::make_unique<AudioOutput>(48000);
+    if (audio_->opened()) {
+        sound_.set_sample_rate(audio_->sample_rate());
+    }
+
+    cartridge_.print_info();
 
     std::cout << "\nControls\n";
     std::cout << "--------" << "\n";
@@ -28,102 +77,452 @@ GameBoy::GameBoy(std::string bootrom_file, std::string cartridge_file) {
     std::cout << "SELECT: Z" << "\n";
     std::cout << "START: X" << "\n";
     std::cout << "D-PAD: ARROWS" << "\n";
+    std::cout << "FRAME TIMING: F1" << "\n";
 }
 
 void GameBoy::run() {
-    /* the main game loop of the Game Boy*/
-    
+    /* The main loop: the frames are emulated and paced on their own thread (see emulate_), while this thread, which the
+    SDL window belongs to, polls the input and presents the newest completed frame. A present waiting for vsync or the
+    driver only holds up the next present, never the emulation */
+    std::unique_ptr<PerfCounters> present_counters; // counters only count the thread that made them
+    if (perf_counters_) {
+        present_counters = std::make_unique<PerfCounters>();
+    }
+
+    // the render and present spans go on a timeline track of their own (the polls are too many and too short to show)
+    uint64_t span_start = 0;
+    auto end_span = [&](const char* name) {
+        if (timeline_) {
+            uint64_t span_end = timeline_->now(Timeline::Presentation);
+            timeline_->span(Timeline::Presentation, name, span_start, span_end);
+            span_start = span_end;
+        }
+    };
+
+    std::thread emulation(&GameBoy::emulate_, this);
+    while (running_) {
+        uint64_t section_start = Instrumentation::now();
+        poll_events();
+        input_time_.fetch_add(Instrumentation::now() - section_start, std::memory_order_relaxed);
+
+        // a frame identical to the one on screen is neither uploaded nor presented, and nothing is while the window is
+        // hidden (the frames published meanwhile are left in the exchange, the newest is shown once it is visible again)
+        if (window_visible_ && (frames_.fresh() || repaint_)) {
+            const FrameExchange::Frame& frame = frames_.take();
+            if (repaint_ || frames_.taken_hash() != presented_hash_) {
+                section_start = Instrumentation::now();
+                if (present_counters) {
+                    present_counters->begin(PerfCounters::Present);
+                }
+                span_start = timeline_ ? timeline_->now(Timeline::Presentation) : 0;
+                display_->render(frame);
+                end_span("render");
+                display_->present();
+                end_span("present");
+                if (present_counters) {
+                    present_counters->end(PerfCounters::Present);
+                }
+                present_time_.fetch_add(Instrumentation::now() - section_start, std::memory_order_relaxed);
+                presented_hash_ = frames_.taken_hash();
+                repaint_ = false;
+            }
+        }
+        else {
+            // nothing to show yet: wait for input, or for the next frame to be published. A hidden window only waits for
+            // events (and the title)
+            SDL_WaitEventTimeout(nullptr, window_visible_ ? 1 : 50);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(title_mutex_);
+            if (!title_.empty()) {
+                display_->set_title(title_);
+                title_.clear();
+            }
+        }
+    }
+    emulation.join();
+
+    if (present_counters) {
+        perf_counters_->add(PerfCounters::Present, *present_counters);
+    }
+}
+
+void GameBoy::set_emulation_thread(int cpu, bool realtime) {
+    emulation_cpu_ = cpu;
+    realtime_ = realtime;
+}
+
+void GameBoy::configure_emulation_thread_() {
+    /* Pin the emulation thread to a core and / or give it SCHED_FIFO, if asked to. Both are only hints: a failure (e.g.
+    no permission for a real-time policy) only costs the determinism of the frame times */
+#ifdef __linux__
+    if (emulation_cpu_ >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(emulation_cpu_, &cpus);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0) {
+            std::cout << "Warning: could not pin the emulation thread to CPU " << emulation_cpu_ << "." << std::endl;
+        }
+    }
+    if (realtime_) {
+        sched_param parameters {};
+        parameters.sched_priority = sched_get_priority_min(SCHED_FIFO);
+        if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &parameters) != 0) {
+            std::cout << "Warning: could not give the emulation thread SCHED_FIFO (missing CAP_SYS_NICE or rtprio limit)." << std::endl;
+        }
+    }
+#else
+    if (emulation_cpu_ >= 0 || realtime_) {
+        std::cout << "Warning: thread affinity and SCHED_FIFO are only supported on Linux." << std::endl;
+    }
+#endif
+}
+
+void GameBoy::emulate_() {
+    /* The emulation thread: run a frame, hand it to the presentation thread (unless it was skipped) and its sound to the
+    audio device, then wait until the next frame is due */
+    configure_emulation_thread_();
+
+    // the counters only count the thread that made them: the frame, CPU and render regions get their own, added to
+    // perf_counters_ when run() ends
+    std::unique_ptr<PerfCounters> emulation_counters;
+    if (perf_counters_) {
+        emulation_counters = std::make_unique<PerfCounters>();
+        frame_counters_ = emulation_counters.get();
+        ppu_.attach_perf_counters(frame_counters_);
+    }
+
     /*  The Gameboy has a master clock which is 4.194304 MHz, or 4,194,304 cycles per second 
         Furthermore, the PPU has a 154 scanlines, each of which takes 456 cycles, which means that in total, one frame is 70,224 cycles.
         Overall then, in one frame, we process 4,194,304 / 70,224 frames, giving an effect frame rate of 59.7275 frames per second */
-    const std::chrono::duration<double> frame_length(70224.0 / 4194304.0);
-    unsigned int master_clock_cycles = 0; // keep track of the elapsed cpu cycles
+    const auto frame_length = std::chrono::duration_cast<std::chrono::high_resolution_clock::duration>(std::chrono::duration<double>(70224.0 / 4194304.0));
 
-    // std::cout << frame_length << '\n';
-    
-    // initial white screen
-    // ppu_.clear_screen();
-    // ppu_.render();
+    // the frames are due one frame length apart, from the first one's start
+    auto deadline = std::chrono::high_resolution_clock::now() + frame_length;
+    auto last_report = deadline - frame_length;
+    bool late = false; // the last frame was finished after it was due
+    int skipped = 0; // frames not drawn since the last one that was
+    uint64_t frame = 0;
 
-    // the first frame start time
-    auto frame_start = std::chrono::high_resolution_clock::now();
+    // hand the newest completed frame over to be presented, if it was not yet. It is taken without waiting: the deferred
+    // renderer's threads draw a frame while the next one is emulated, so it is handed over after the pacing (or, when
+    // there is nothing to wait for, once the next frame is emulated)
+    uint64_t published = ppu_.ready_frame_number();
+    auto publish_frame = [&]() {
+        ppu_.poll_frame();
+        if (ppu_.ready_frame_number() != published) {
+            frames_.back() = ppu_.ready_frame();
+            frames_.publish(ppu_.ready_hash());
+            published = ppu_.ready_frame_number();
+        }
+    };
+
+    // record the phases of every frame as consecutive spans on the timeline, if there is one
+    uint64_t span_start = 0;
+    auto end_span = [&](const char* name) {
+        if (timeline_) {
+            uint64_t span_end = timeline_->now(Timeline::Host);
+            timeline_->span(Timeline::Host, name, span_start, span_end);
+            span_start = span_end;
+        }
+    };
 
     while (running_) {
+        // the buttons held when the frame starts
+        joypad_.set_state(input_.load(std::memory_order_relaxed));
+
+        // draw the frame, unless it is one of the frames skipped
+        bool render = frame_skip_ >= 0 ? frame % (frame_skip_ + 1) == 0 : !late || skipped >= max_auto_skip;
+        ppu_.set_rendering(render);
+        skipped = render ? 0 : skipped + 1;
+        frame++;
+
         // can run a maximum of 70224 cycles in a frame (yields 4.194304 MHz)
-        if (master_clock_cycles < 70224) {
+        if (timeline_) {
+            span_start = timeline_->now(Timeline::Host);
+        }
+        run_frame();
+        end_span("emulate");
+
+        publish_frame();
+
+        // play the frame's sound, and produce the next frame's a little faster or slower if the audio device's clock drifts
+        // away from the pace of the frames (unless it sets the pace)
+        samples_.resize(2 * sound_.samples_available());
+        audio_->queue(samples_.data(), sound_.read_samples(samples_.data(), sound_.samples_available()));
+        sound_.set_rate_adjustment(audio_sync_ ? 1 : audio_->rate_adjustment());
+        end_span("handover");
+
+        // the presentation thread's time since the last frame
+        instrumentation_.add(Instrumentation::Input, input_time_.exchange(0, std::memory_order_relaxed));
+        instrumentation_.add(Instrumentation::Present, present_time_.exchange(0, std::memory_order_relaxed));
+
+        // wait until the next frame is due, or until the audio device needs its sound (the frame is late if there is nothing
+        // left to wait for). Sleep most of the way, and only yield the last millisecond, which sleeping could overshoot
+        uint64_t section_start = Instrumentation::now();
+        auto frame_end = std::chrono::high_resolution_clock::now();
+        if (audio_sync_ && audio_->opened()) {
+            late = audio_->wants_samples();
+            while (running_ && !audio_->wants_samples()) {
+                std::this_thread::sleep_for(std::chrono::microseconds(250));
+            }
+        }
+        else {
+            late = frame_end > deadline;
+            std::this_thread::sleep_until(deadline - std::chrono::milliseconds(1));
+            while (running_ && std::chrono::high_resolution_clock::now() < deadline) {
+                std::this_thread::yield();
+            }
+        }
+        instrumentation_.add(Instrumentation::Pacing, Instrumentation::now() - section_start);
+        instrumentation_.end_frame();
+        end_span("pacing");
+        publish_frame();
+
+        // the next frame is due a frame length after this one was, so the frames after a late one catch up (skipping
+        // their drawing, with the auto frame skip). A frame late by more than a few (e.g. the host was suspended) starts
+        // the schedule over instead
+        deadline += frame_length;
+        if (frame_end > deadline + 4 * frame_length) {
+            deadline = frame_end + frame_length;
+        }
+
+        if (show_stats_ && instrumentation_.frames() % 30 == 0) {
+            std::lock_guard<std::mutex> lock(title_mutex_);
+            title_ = "GameBoy 1989 | " + instrumentation_.summary();
+        }
+        if (stats_interval_ > 0 && std::chrono::duration<double>(frame_end - last_report).count() >= stats_interval_) {
+            instrumentation_.write_report(std::cout);
+            last_report = frame_end;
+        }
+    }
+
+    if (emulation_counters) {
+        for (PerfCounters::Region region : {PerfCounters::Frame, PerfCounters::CPU, PerfCounters::Render}) {
+            perf_counters_->add(region, *emulation_counters);
+        }
+        frame_counters_ = perf_counters_.get();
+        ppu_.attach_perf_counters(frame_counters_);
+    }
+}
+
+void GameBoy::run_frame() {
+    /* run the hardware components for the 70224 master clock cycles of one frame */
+    if (perf_counters_) {
+        frame_counters_->begin(PerfCounters::Frame);
+    }
+    uint64_t emulation_start = Instrumentation::now();
+    for (unsigned int master_clock_cycles = 0; master_clock_cycles < 70224; master_clock_cycles++) {
+        if (master_clock_cycles % Instrumentation::sample_stride == 0) {
+            // time the components separately on a few cycles, to know how to split the time of the whole loop
+            uint64_t cpu_start = Instrumentation::now();
+            if (perf_counters_) {
+                frame_counters_->begin(PerfCounters::CPU);
+                cpu_.cycle();
+                frame_counters_->end(PerfCounters::CPU, Instrumentation::sample_stride);
+            }
+            else {
+                cpu_.cycle();
+            }
+            uint64_t ppu_start = Instrumentation::now();
+            ppu_.cycle();
+            uint64_t timers_start = Instrumentation::now();
+            timers_.increment_cycle_counter();
+            instrumentation_.add_emulation_sample(ppu_start - cpu_start, timers_start - ppu_start, Instrumentation::now() - timers_start);
+        }
+        else {
             cpu_.cycle();
             ppu_.cycle();
             timers_.increment_cycle_counter();
-            master_clock_cycles++;
         }
-        else if (master_clock_cycles == 70224) {
-            // number of cycles to complete frame, so render
-            // std::cout << "Processing done: " << std::chrono::high_resolution_clock::now() - frame_start << '\n';
 
-            // poll for a quit event (e.g. user exits out of the emulator)
-            poll_events();
+        // the CPU is halted, or has just started another iteration of a busy-wait loop
+        if (cpu_.waiting()) {
+            master_clock_cycles += skip_waiting_(master_clock_cycles);
+        }
+    }
+    // the APU only runs when its registers are accessed: bring it up to the end of the frame
+    sound_.end_frame(cpu_.cycle_count());
+    instrumentation_.end_emulation(Instrumentation::now() - emulation_start);
+    if (perf_counters_) {
+        frame_counters_->end(PerfCounters::Frame);
+        perf_counters_->set_emulated_instructions(cpu_.instruction_count() - perf_instructions_start_);
+    }
+
+    // without a window there is nothing else to do in a frame
+    if (headless_) {
+        instrumentation_.end_frame();
+    }
+}
 
-            // render the texture to the screen
-            ppu_.clear_screen();
-            // std::cout << "Clearing done: " << std::chrono::high_resolution_clock::now() - frame_start << '\n';
-            ppu_.render();
+uint32_t GameBoy::skip_waiting_(unsigned int master_clock_cycle) {
+    /* Called after master_clock_cycle has run: let the following cycles in which the CPU would only wait pass at once, and
+    return how many there were */
+    uint32_t frame_left = 70224 - master_clock_cycle - 1;
+    uint32_t loop_cycles = cpu_.idle_loop_cycles();
+    uint32_t cycles = 0;
 
-            // std::cout << "Rendering done: " << std::chrono::high_resolution_clock::now() - frame_start << '\n';
-            master_clock_cycles++;
+    if (cpu_.halted()) {
+        // a halted CPU only waits for an interrupt, so skip to the next PPU mode change or TIMA increment (the only places an
+        // interrupt can be requested during a frame, input arrives between frames)
+        cycles = std::min({ppu_.idle_cycles(), timers_.idle_cycles(), frame_left});
+        cpu_.skip_halted(cycles);
+    }
+    else if (loop_cycles > 0) {
+        // a busy-wait loop repeats exactly as long as nothing it reads changes: if nothing changed during its last iteration (nor
+        // since the start of the frame, when the input may have), skip whole iterations up to the next PPU or timer change. DIV
+        // changes every 256 cycles, so it only counts for loops that read it, and so does NR52 (on frame sequencer steps)
+        bool reads_div = timers_.div_read_within(loop_cycles + 1);
+        uint64_t now = cpu_.cycle_count();
+        bool reads_sound = sound_.status_read_within(now, loop_cycles + 1);
+        uint32_t quiet = std::min(ppu_.quiet_cycles(), timers_.quiet_cycles(reads_div));
+        uint32_t steady = std::min({ppu_.idle_cycles(), timers_.steady_cycles(reads_div), frame_left});
+        if (reads_sound) {
+            quiet = std::min(quiet, sound_.quiet_cycles(now));
+            steady = std::min(steady, sound_.steady_cycles(now));
         }
-        else {
-            // waste time until frame length is up
-            poll_events();
-            if (std::chrono::high_resolution_clock::now() - frame_start >= frame_length) {
-                // the frame is now official over, can start prossessing again
-                // std::cout << "Frame Complete: " << std::chrono::high_resolution_clock::now() - frame_start << '\n';
-                master_clock_cycles = 0;
-                frame_start = std::chrono::high_resolution_clock::now();
-            }
+        if (master_clock_cycle >= loop_cycles && quiet > loop_cycles) {
+            uint32_t iterations = steady / loop_cycles;
+            cpu_.skip_idle_loop(iterations);
+            cycles = iterations * loop_cycles;
         }
+    }
 
-        
+    ppu_.skip(cycles);
+    timers_.skip(cycles);
+    return cycles;
+}
+
+void GameBoy::set_stats_interval(double seconds) {
+    stats_interval_ = seconds;
+}
 
+void GameBoy::set_audio_latency(double seconds) {
+    if (audio_) {
+        audio_->set_latency(seconds);
     }
 }
 
+void GameBoy::set_audio_sync(bool sync) {
+    audio_sync_ = sync;
+}
+
+void GameBoy::set_rtc_clock(bool emulated) {
+    cartridge_.set_rtc_clock(emulated ? &cpu_ : nullptr);
+}
+
+PerfCounters& GameBoy::start_perf_counters() {
+    perf_counters_ = std::make_unique<PerfCounters>();
+    frame_counters_ = perf_counters_.get();
+    perf_instructions_start_ = cpu_.instruction_count();
+    ppu_.attach_perf_counters(frame_counters_);
+    return *perf_counters_;
+}
+
+void GameBoy::start_timeline(std::string timeline_file) {
+    timeline_ = std::make_unique<Timeline>(timeline_file, &cpu_);
+    bus_.set_timeline(timeline_.get());
+    interrupts_.set_timeline(timeline_.get());
+}
+
+void GameBoy::set_input(uint8_t buttons) {
+    joypad_.set_state(buttons);
+}
+
+#ifdef GB_TRACE
+void GameBoy::start_trace(std::string trace_file) {
+    tracer_ = std::make_unique<Tracer>(trace_file);
+    cpu_.attach_tracer(tracer_.get());
+}
+#endif
+
+#ifdef GB_PROFILE
+Profiler& GameBoy::start_profile(bool exact, uint32_t sample_period) {
+    profiler_ = std::make_unique<Profiler>(&cartridge_, exact, sample_period);
+    cpu_.attach_profiler(profiler_.get());
+    return *profiler_;
+}
+#endif
+
+uint64_t GameBoy::frame_hash() {
+    return ppu_.frame_hash();
+}
+
+void GameBoy::set_rendering(bool render) {
+    ppu_.set_rendering(render);
+}
+
+bool GameBoy::frame_rendered() {
+    return ppu_.frame_rendered();
+}
+
+void GameBoy::set_frame_skip(int frames) {
+    frame_skip_ = frames;
+}
+
 void GameBoy::poll_events() {
     SDL_Event event;
     while (SDL_PollEvent(&event)) {
         switch (event.type) {
-            case SDL_KEYDOWN:
-                // modify the lower 4 bits of the joypad register
+            case SDL_KEYDOWN: {
+                // one direction and one button at a time: a key replaces the one held in its half of the mask
+                uint8_t pressed = input_.load(std::memory_order_relaxed);
                 switch (event.key.keysym.sym) {
-                    // only modify the directional keys if the dpad is enabled
                     case SDLK_RIGHT:
-                        joypad_.set_dpad(0b1110);
+                        pressed = (pressed & 0xf0) | Joypad::Right;
                         break;
                     case SDLK_LEFT:
-                        joypad_.set_dpad(0b1101);
+                        pressed = (pressed & 0xf0) | Joypad::Left;
                         break;
                     case SDLK_UP:
-                        joypad_.set_dpad(0b1011);
+                        pressed = (pressed & 0xf0) | Joypad::Up;
                         break;
                     case SDLK_DOWN:
-                        joypad_.set_dpad(0b0111);
+                        pressed = (pressed & 0xf0) | Joypad::Down;
                         break;
                     case SDLK_a:
-                        joypad_.set_buttons(0b1110);
+                        pressed = (pressed & 0x0f) | Joypad::A;
                         break;
                     case SDLK_s:
-                        joypad_.set_buttons(0b1101);
+                        pressed = (pressed & 0x0f) | Joypad::B;
                         break;
                     case SDLK_z:
-                        joypad_.set_buttons(0b1011);
+                        pressed = (pressed & 0x0f) | Joypad::Select;
                         break;
                     case SDLK_x:
-                        joypad_.set_buttons(0b0111);
+                        pressed = (pressed & 0x0f) | Joypad::Start;
+                        break;
+                    case SDLK_F1:
+                        show_stats_ = !show_stats_;
+                        if (!show_stats_) {
+                            display_->set_title("GameBoy 1989");
+                        }
                         break;
                 }
+                // the emulation thread reads it at the start of every frame
+                input_.store(pressed, std::memory_order_relaxed);
                 break;
+            }
             case SDL_KEYUP:
-                joypad_.set_dpad(0xf);
-                joypad_.set_buttons(0xf);
+                input_.store(0, std::memory_order_relaxed);
+                break;
+            case SDL_WINDOWEVENT:
+                switch (event.window.event) {
+                    case SDL_WINDOWEVENT_MINIMIZED:
+                    case SDL_WINDOWEVENT_HIDDEN:
+                        window_visible_ = false;
+                        break;
+                    case SDL_WINDOWEVENT_SHOWN:
+                    case SDL_WINDOWEVENT_RESTORED:
+                    case SDL_WINDOWEVENT_MAXIMIZED:
+                    case SDL_WINDOWEVENT_EXPOSED:
+                    case SDL_WINDOWEVENT_SIZE_CHANGED:
+                        // the window's contents are gone or stretched: draw the frame again even if it did not change
+                        window_visible_ = true;
+                        repaint_ = true;
+                        break;
+                }
                 break;
             case SDL_QUIT:
                 running_ = false;
@@ -135,5 +534,17 @@ void GameBoy::poll_events() {
 }
 
 GameBoy::~GameBoy() {
-    SDL_Quit();
-}
\ No newline at end of file
+#ifdef GB_STATS
+    std::ofstream stats_writer(stats_file_, std::ios::trunc);
+    if (stats_writer) {
+        bus_.stats().write_report(stats_writer);
+    }
+    else {
+        std::cout << "Warning: could not write the stats report to " << stats_file_ << "." << std::endl;
+    }
+#endif
+}
+
+std::unique_ptr<GameBoy> load_or_exit(std::string bootrom_file, std::string cartridge_file, bool headless) {
+    return load_or_exit([&]() { return std::make_unique<GameBoy>(bootrom_file, cartridge_file, headless); });
+}
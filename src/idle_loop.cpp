@@ -0,0 +1,95 @@
+#include "idle_loop.h"
+#include "bus.h"
+
+// loops the heuristic does not find on its own, per ROM. To add one, find the loop with gameboy-profile (it will be the
+// hottest few instructions of a frame), and enter the ROM's header checksum (0x14d), global checksum (0x14e - 0x14f,
+// big endian), the loop's start address and its length up to and including the backward jump, e.g.
+//     {0x3a, 0x1234, 0x0210, 24},
+static const std::vector<IdleLoop::Override> override_table = {
+};
+
+std::vector<IdleLoop::Override> IdleLoop::overrides_for(uint8_t header_checksum, uint16_t global_checksum)
+{
+    std::vector<Override> overrides;
+    for (const Override& entry : override_table) {
+        if (entry.header_checksum == header_checksum && entry.global_checksum == global_checksum) {
+            overrides.push_back(entry);
+        }
+    }
+    return overrides;
+}
+
+void IdleLoop::new_loop_(uint16_t from, uint16_t to)
+{
+    uint16_t length = max_length;
+    bool writes_allowed = false;
+    for (const Override& entry : overrides_) {
+        if (entry.address == to) {
+            length = entry.length;
+            writes_allowed = true;
+        }
+    }
+    if (from - to > length) {
+        return;
+    }
+
+    // start over with the new loop, the first iteration starts when its start is fetched
+    start_ = to;
+    closed_by_ = from;
+    rejected_ = UINT32_MAX;
+    writes_allowed_ = writes_allowed;
+    tracking_ = false;
+    repeated_ = false;
+    misses_ = 0;
+}
+
+void IdleLoop::iteration(const Registers& registers, uint64_t cycle, uint64_t instructions)
+{
+    /* An iteration ended: if it did not do anything that could change the next one, and it left the registers as it found them,
+    the next iteration repeats it as long as the memory it reads holds the same values (see GameBoy::run_frame) */
+    repeated_ = tracking_ && idle_ && registers == registers_;
+    if (tracking_ && !repeated_ && ++misses_ >= max_misses) {
+        // most likely a loop doing work (e.g. counting down): stop watching it
+        rejected_ = start_;
+        rejected_by_ = closed_by_;
+        start_ = UINT32_MAX;
+        tracking_ = false;
+        return;
+    }
+    if (repeated_) {
+        misses_ = 0;
+        cycles_ = cycle - start_cycle_;
+        instructions_ = instructions - start_instructions_;
+    }
+
+    tracking_ = true;
+    idle_ = true;
+    registers_ = registers;
+    start_cycle_ = cycle;
+    start_instructions_ = instructions;
+}
+
+void IdleLoop::write(uint16_t address, uint8_t value, Bus* bus)
+{
+    // only loops listed as overrides may write, and only the value already in work RAM / HRAM
+    bool ram = (address >= 0xc000 && address <= 0xdfff) || (address >= 0xff80 && address <= 0xfffe);
+    if (!writes_allowed_ || !ram || bus->read(address) != value) {
+        idle_ = false;
+    }
+}
+
+uint32_t IdleLoop::repeating_cycles()
+{
+    if (!repeated_) {
+        return 0;
+    }
+    repeated_ = false;
+    return cycles_;
+}
+
+uint64_t IdleLoop::skip(uint32_t iterations)
+{
+    start_cycle_ += static_cast<uint64_t>(iterations) * cycles_;
+    start_instructions_ += iterations * instructions_;
+    return iterations * instructions_;
+}
\ No newline at end of file
@@ -0,0 +1,103 @@
+#include "instrumentation.h"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+Instrumentation::Instrumentation()
+{
+    start_ticks_ = now();
+    start_time_ = std::chrono::steady_clock::now();
+    last_frame_end_ = start_ticks_;
+}
+
+void Instrumentation::end_emulation(uint64_t ticks)
+{
+    /* the sampled cycles include the cost of reading the clock, so only their proportions are used */
+    uint64_t sampled = samples_[CPU] + samples_[PPU] + samples_[Timers];
+    if (sampled == 0) {
+        current_[CPU] += ticks;
+    }
+    else {
+        current_[PPU] += ticks * samples_[PPU] / sampled;
+        current_[Timers] += ticks * samples_[Timers] / sampled;
+        current_[CPU] += ticks - ticks * samples_[PPU] / sampled - ticks * samples_[Timers] / sampled;
+    }
+    samples_.fill(0);
+}
+
+void Instrumentation::end_frame()
+{
+    uint64_t frame_end = now();
+    current_[Frame] = frame_end - last_frame_end_;
+    last_frame_end_ = frame_end;
+
+    for (int section = 0; section < section_count; section++) {
+        history_[section][frames_ % history] = current_[section];
+    }
+    current_.fill(0);
+    frames_++;
+
+#if defined(__x86_64__) || defined(__i386__)
+    // calibrate the TSC against steady_clock over everything measured so far
+    double elapsed_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start_time_).count();
+    if (elapsed_us > 10000.0) {
+        ticks_per_us_ = (frame_end - start_ticks_) / elapsed_us;
+    }
+#endif
+}
+
+Instrumentation::Stats Instrumentation::stats(Section section) const
+{
+    Stats result;
+    size_t count = std::min<uint64_t>(frames_, history);
+    if (count == 0) {
+        return result;
+    }
+
+    std::vector<uint64_t> times(history_[section].begin(), history_[section].begin() + count);
+    uint64_t sum = 0;
+    for (uint64_t time : times) {
+        sum += time;
+    }
+    result.mean_us = sum / ticks_per_us_ / count;
+
+    std::nth_element(times.begin(), times.begin() + count / 2, times.end());
+    result.p50_us = times[count / 2] / ticks_per_us_;
+    size_t p99 = std::min(count - 1, count * 99 / 100);
+    std::nth_element(times.begin(), times.begin() + p99, times.end());
+    result.p99_us = times[p99] / ticks_per_us_;
+    result.max_us = *std::max_element(times.begin(), times.end()) / ticks_per_us_;
+    return result;
+}
+
+double Instrumentation::fps() const
+{
+    Stats frame = stats(Frame);
+    return frame.mean_us > 0 ? 1000000.0 / frame.mean_us : 0;
+}
+
+std::string Instrumentation::summary() const
+{
+    /* e.g. "59.7 fps | cpu 2.10 ppu 1.32 timers 0.21 present 0.40 ms | p99 frame 16.9 ms" */
+    std::stringstream stream;
+    stream << std::fixed << std::setprecision(1) << fps() << " fps |" << std::setprecision(2);
+    for (Section section : {CPU, PPU, Timers, Present}) {
+        stream << " " << section_names[section] << " " << stats(section).mean_us / 1000.0;
+    }
+    stream << " ms | p99 frame " << std::setprecision(1) << stats(Frame).p99_us / 1000.0 << " ms";
+    return stream.str();
+}
+
+void Instrumentation::write_report(std::ostream& out) const
+{
+    out << "Frame timing over the last " << std::min<uint64_t>(frames_, history) << " frames (" << std::fixed << std::setprecision(1) << fps() << " fps), in ms:\n";
+    out << std::setw(10) << "section" << std::setw(10) << "mean" << std::setw(10) << "p50" << std::setw(10) << "p99" << std::setw(10) << "max" << "\n";
+    for (int section = 0; section < section_count; section++) {
+        Stats section_stats = stats(static_cast<Section>(section));
+        out << std::setw(10) << section_names[section] << std::setprecision(3)
+            << std::setw(10) << section_stats.mean_us / 1000.0 << std::setw(10) << section_stats.p50_us / 1000.0
+            << std::setw(10) << section_stats.p99_us / 1000.0 << std::setw(10) << section_stats.max_us / 1000.0 << "\n";
+    }
+    out << std::flush;
+}
\ No newline at end of file
@@ -0,0 +1,10 @@
+#include "interrupts.h"
+#include "timeline.h"
+
+void InterruptController::record_(Kind kind)
+{
+    // only a new request shows up on the timeline, like a write to IF setting the bit
+    if (!(if_ & kind)) {
+        timeline_->instant(Timeline::Interrupts, names[std::countr_zero(static_cast<unsigned int>(kind))]);
+    }
+}
@@ -25,6 +25,13 @@ void Joypad::set_dpad(uint8_t value)
     dpad_ = value;
 }
 
+void Joypad::set_state(uint8_t pressed)
+{
+    // a pressed button reads as 0
+    dpad_ = ~pressed & 0xf;
+    buttons_ = (~pressed >> 4) & 0xf;
+}
+
 void Joypad::set_selection(uint8_t value)
 {
     selection_ &= 0x0f;
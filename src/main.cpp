@@ -1,25 +1,97 @@
 #include "gameboy.h"
 #include <iostream>
+#include <memory>
 #include <ostream>
+#include <string>
 
 int main(int argc, char* argv[]) 
 {
-    if (argc < 2) {
+    if (argc < 3) {
         std::cout << "Please provide path to BOOTROM .bin file, and path to the ROM file." << std::endl;
+        std::cout << "Options: --trace <trace file>, --timeline <trace.json>, --perf, --stats <seconds between frame timing reports>, --latency <ms>, --audio-sync, --rtc host|emulated, --renderer scanline|fifo|deferred, --affinity <cpu>, --realtime, --frameskip auto|<frames>" << std::endl;
         exit(-1);
     }
-    else if (argc != 3) {
-        std::cout << "Please provide path to ROM file." << std::endl;
-        exit(-1);
-    }
-    else if (argc == 3) {
-        std::cout << "Running game: " << argv[2] << std::endl;
-    }
-    else {
-        std::cout << "Invalid number of arguments. Only specify BOOTROM .bin file, and path to the ROM file." << std::endl;
+
+    std::cout << "Running game: " << argv[2] << std::endl;
+    std::unique_ptr<GameBoy> loaded = load_or_exit(argv[1], argv[2]);
+    GameBoy& gameboy = *loaded;
+    int emulation_cpu = -1;
+    bool realtime = false;
+
+    for (int i = 3; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--trace" && i + 1 < argc) {
+#ifdef GB_TRACE
+            load_or_exit([&]() { gameboy.start_trace(argv[++i]); });
+#else
+            std::cout << "Error: tracing is not compiled in, rebuild with -DGAMEBOY_TRACE=ON." << std::endl;
+            exit(-1);
+#endif
+        }
+        else if (arg == "--timeline" && i + 1 < argc) {
+            gameboy.start_timeline(argv[++i]);
+        }
+        else if (arg == "--perf") {
+            gameboy.start_perf_counters();
+        }
+        else if (arg == "--stats" && i + 1 < argc) {
+            gameboy.set_stats_interval(std::stod(argv[++i]));
+        }
+        else if (arg == "--latency" && i + 1 < argc) {
+            gameboy.set_audio_latency(std::stod(argv[++i]) / 1000);
+        }
+        else if (arg == "--audio-sync") {
+            gameboy.set_audio_sync(true);
+        }
+        else if (arg == "--rtc" && i + 1 < argc) {
+            std::string clock = argv[++i];
+            if (clock != "host" && clock != "emulated") {
+                std::cout << "Error: --rtc takes host or emulated." << std::endl;
+                exit(-1);
+            }
+            gameboy.set_rtc_clock(clock == "emulated");
+        }
+        else if (arg == "--affinity" && i + 1 < argc) {
+            emulation_cpu = std::stoi(argv[++i]);
+        }
+        else if (arg == "--realtime") {
+            realtime = true;
+        }
+        else if (arg == "--frameskip" && i + 1 < argc) {
+            std::string frames = argv[++i];
+            int skip = frames == "auto" ? -1 : std::stoi(frames);
+            if (skip < -1 || (skip == -1 && frames != "auto")) {
+                std::cout << "Error: --frameskip takes auto or a number of frames." << std::endl;
+                exit(-1);
+            }
+            gameboy.set_frame_skip(skip);
+        }
+        else if (arg == "--renderer" && i + 1 < argc) {
+            std::string renderer = argv[++i];
+            if (renderer == "scanline") {
+                gameboy.ppu().set_renderer(PPU::Renderer::Scanline);
+            }
+            else if (renderer == "fifo") {
+                gameboy.ppu().set_renderer(PPU::Renderer::PixelFifo);
+            }
+            else if (renderer == "deferred") {
+                gameboy.ppu().set_renderer(PPU::Renderer::Deferred);
+            }
+            else {
+                std::cout << "Error: --renderer takes scanline, fifo or deferred." << std::endl;
+                exit(-1);
+            }
+        }
+        else {
+            std::cout << "Error: unknown option " << arg << std::endl;
+            exit(-1);
+        }
     }
 
-    GameBoy gameboy{argv[1], argv[2]};
+    gameboy.set_emulation_thread(emulation_cpu, realtime);
     gameboy.run();
+    if (gameboy.perf_counters()) {
+        gameboy.perf_counters()->write_report(std::cout);
+    }
     return 0;
 }
\ No newline at end of file
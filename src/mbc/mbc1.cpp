@@ -5,32 +5,16 @@ uint8_t MBC1::read(uint16_t address)
 {
     if (address >= 0x0000 && address <= 0x3fff) {
         // this is the fixed bank area (ROM bank X0)
-        if (banking_mode_ == 0) {
-            return cartridge_data_[address];
-        }
-        else {
-           return cartridge_data_[(static_cast<uint32_t>(ram_bank_reg_) << 19) + address];
-        }
+        return cartridge_data_[rom_address_(banking_mode_ == 0 ? 0 : upper_bank_(), address)];
     }
     else if (address >= 0x4000 && address <= 0x7fff) {
         // this is the switchable bank area (ROM bank 01 - 7f)
-        // following commented lines yield correct behaviour:
-        // uint offset = address - 0x4000;
-        // uint address = 0x4000 * rom_bank_number_;
-        // return cartridge_data_[offset + address];
-        return cartridge_data_[(static_cast<uint32_t>(ram_bank_reg_) << 19) + (static_cast<uint32_t>(rom_bank_number_) << 14) + address];
+        return cartridge_data_[rom_address_(upper_bank_() | rom_bank_number_, address)];
     }
     else if (address >= 0xa000 && address <= 0xbfff) {
-        // RAM bank 00-03. We can only read RAM values if RAM is enabled
-        if (ram_enable_) {
-            if (banking_mode_ == 0) {
-                return cartridge_data_[address];
-            }
-            else {
-                return cartridge_data_[(static_cast<uint16_t>(ram_bank_reg_) << 13) + address];
-            }
-            // after accessing external RAM, disable it
-            ram_enable_ = false;
+        // RAM bank 00-03. We can only read RAM values if RAM is enabled (and the cartridge has some)
+        if (ram_enable_ && external_ram_->size() > 0) {
+            return external_ram_->read(ram_address_(address));
         }
         else {
             // RAM is not enabled so return junk data
@@ -47,31 +31,12 @@ void MBC1::write(uint16_t address, uint8_t value)
     if (address >= 0x0000 && address <= 0x1fff) {
         // if the last 4 bits of value contain the value a, enable ram. Any other value disables it
         uint8_t lower_bits = value & 0xf;
-        if (lower_bits == 0xa) {
-            ram_enable_ = true;
-        }
-        else {
-            ram_enable_ = false;
-        }
+        set_ram_enable_(lower_bits == 0xa);
     }
     else if (address >= 0x2000 && address <= 0x3fff) {
-        // sets the ROM bank number, which selects which ROM bank is exposed to the 4000-7fff region 
-        switch (rom_size_code) {
-            case 0x0:
-                break; // no banking
-            case 0x1:
-                rom_bank_number_ = value & 0x3; // 4 banks, use 2 bits
-                break;
-            case 0x2:
-                rom_bank_number_ = value & 0x7; // 8 banks, use 3 bits
-                break;
-            case 0x3:
-                rom_bank_number_ = value & 0xf; // 16 banks, use 4 bits
-                break;
-            case 0x4:
-                rom_bank_number_ = value & 0x1f; // 32 banks, use 5 bits
-                break;
-        }
+        // sets the ROM bank number, which selects which ROM bank is exposed to the 4000-7fff region. The register has 5 bits
+        // on every cartridge, and a 0 in them selects bank 1; the bits past the ROM's bank count are ignored when reading
+        rom_bank_number_ = value & 0x1f;
         if (rom_bank_number_ == 0) {
             rom_bank_number_++;
         }
@@ -85,26 +50,48 @@ void MBC1::write(uint16_t address, uint8_t value)
         }
     }
     else if (address >= 0x6000 && address <= 0x7fff) {
-        /* select MBC1 banking mode */
-        if (value == 0x0) {
-            banking_mode_ = 1;
-        }
-        else {
-            banking_mode_ = 0;
-        }
+        /* select MBC1 banking mode: in mode 1 the secondary register also switches the RAM bank and the bank at 0x0000 */
+        banking_mode_ = value & 0x1;
     }
 
-    else if (address >= 0xa000 && address <= 0xbfff && ram_enable_) {
+    else if (address >= 0xa000 && address <= 0xbfff) {
         // RAM bank 00-03. We can only write to RAM values if RAM is enabled
-        if (ram_enable_) {
-            if (banking_mode_ == 0) {
-                cartridge_data_[address] = value;
-            }
-            else {
-                cartridge_data_[(static_cast<uint16_t>(ram_bank_reg_) << 13) + address] = value;
-            }
-            // after accessing external RAM, disable it
-            ram_enable_ = false;
+        if (ram_enable_ && external_ram_->size() > 0) {
+            external_ram_->write(ram_address_(address), value);
         }
     }
+}
+
+const uint8_t* MBC1::memory(uint16_t address)
+{
+    /* the same banks read() reads from */
+    if (address <= 0x3fff) {
+        return &cartridge_data_[rom_address_(banking_mode_ == 0 ? 0 : upper_bank_(), address)];
+    }
+    else if (address <= 0x7fff) {
+        return &cartridge_data_[rom_address_(upper_bank_() | rom_bank_number_, address)];
+    }
+    else if (address >= 0xa000 && address <= 0xbfff && ram_enable_ && external_ram_->size() > 0) {
+        return external_ram_->data() + ram_address_(address);
+    }
+    return nullptr;
+}
+
+uint32_t MBC1::upper_bank_()
+{
+    /* on 1 MiB and larger ROMs the secondary register holds bits 5 - 6 of the ROM bank, otherwise it is only the RAM bank */
+    return rom_size_code >= 0x05 ? static_cast<uint32_t>(ram_bank_reg_) << 5 : 0;
+}
+
+uint32_t MBC1::rom_address_(uint32_t bank, uint16_t address)
+{
+    /* the ROM only has as many address lines as it needs: a bank number past its end wraps around */
+    return ((bank << 14) | (address & 0x3fff)) % cartridge_data_.size();
+}
+
+uint32_t MBC1::ram_address_(uint16_t address)
+{
+    /* the secondary register only selects the RAM bank in mode 1. Smaller RAMs (2 / 8 KiB) repeat across the area */
+    uint32_t bank = banking_mode_ == 1 ? ram_bank_reg_ : 0;
+    return ((bank << 13) | (address - 0xa000)) % external_ram_->size();
 }
\ No newline at end of file
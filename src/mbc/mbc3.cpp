@@ -1,4 +1,6 @@
 #include "./mbc/mbc3.h"
+#include "cpu.h"
+#include <chrono>
 #include <cstdint>
 #include <iostream>
 #include <vector>
@@ -19,10 +21,10 @@ uint8_t MBC3::read(uint16_t address)
     else if (address >= 0xa000 && address <= 0xbfff) {
         // RAM bank 00-03. We can only read RAM values if RAM is enabled
         if (ram_bank_reg_ <= 0x3) {
-            if (ram_enable_) {
+            if (ram_enable_ && external_ram_->size() > 0) {
                 uint offset = address - 0xa000;
                 uint ram_address = offset + (0x2000 * ram_bank_reg_);
-                return external_ram.at(ram_address);
+                return external_ram_->read(ram_address % external_ram_->size());
             }
             else {
                 // RAM is not enabled so return junk data
@@ -31,6 +33,7 @@ uint8_t MBC3::read(uint16_t address)
         }
         else if (ram_bank_reg_ >= 0x8 && ram_bank_reg_ <= 0xc) {
             if (rtc_rw_enable_) {
+                start_rtc_(); // the latched registers may come from the save file
                 switch (ram_bank_reg_) {
                     case 0x8:
                         return rtc_s;
@@ -53,20 +56,33 @@ uint8_t MBC3::read(uint16_t address)
     return cartridge_data_[address]; 
 }
 
+const uint8_t* MBC3::memory(uint16_t address)
+{
+    /* the same banks read() reads from */
+    if (address <= 0x3fff) {
+        return &cartridge_data_[address];
+    }
+    else if (address <= 0x7fff) {
+        return &cartridge_data_[0x4000 * rom_bank_number_ + (address - 0x4000)];
+    }
+    else if (address >= 0xa000 && address <= 0xbfff && ram_bank_reg_ <= 0x3 && ram_enable_ && external_ram_->size() > 0) {
+        return external_ram_->data() + (address - 0xa000 + 0x2000 * ram_bank_reg_) % external_ram_->size();
+    }
+    return nullptr;
+}
+
 void MBC3::write(uint16_t address, uint8_t value)
 {
     /* the write function of the MBC changes the MBC control registers */
     if (address >= 0x0000 && address <= 0x1fff) {
         // if the last 4 bits of value contain the value a, enable ram. Any other value disables it
         uint8_t lower_bits = value & 0xf;
-        if (lower_bits == 0xa) {
-            ram_enable_ = true;
-            rtc_rw_enable_= true;
-        }
-        else {
-            ram_enable_ = false;
-            rtc_rw_enable_ = false;
+        if (has_rtc_ && rtc_started_ && ram_enable_ && lower_bits != 0xa) {
+            // the game is done with the cartridge for now: the clock is saved with the RAM
+            write_rtc_footer_();
         }
+        set_ram_enable_(lower_bits == 0xa);
+        rtc_rw_enable_ = lower_bits == 0xa;
     }
     else if (address >= 0x2000 && address <= 0x3fff) {
         // sets the ROM bank number, which selects which ROM bank is exposed to the 4000-7fff region 
@@ -118,38 +134,210 @@ void MBC3::write(uint16_t address, uint8_t value)
     else if (address >= 0xa000 && address <= 0xbfff) {
         // RAM bank 00-03. We can only write to RAM values if RAM is enabled
         if (ram_bank_reg_ <= 0x3) {
-            if (ram_enable_) {
+            if (ram_enable_ && external_ram_->size() > 0) {
                 uint offset = address - 0xa000;
                 uint ram_address = offset + (0x2000 * ram_bank_reg_);
-                external_ram[ram_address] = value;
+                external_ram_->write(ram_address % external_ram_->size(), value);
             }
         }
         else if (ram_bank_reg_ >= 0x8 && ram_bank_reg_ <= 0xc) {
             if (rtc_rw_enable_) {
-                switch (ram_bank_reg_) {
-                    case 0x8:
-                        rtc_s = value;
-                        break;
-                    case 0x9:
-                        rtc_m = value;
-                        break;
-                    case 0xa:
-                        rtc_h = value;
-                        break;
-                    case 0xb:
-                        rtc_dl = value;
-                        break;
-                    case 0xc:
-                        rtc_dh = value;
-                        break;
-                }
+                write_rtc_(ram_bank_reg_, value);
             }
         }
     }
 }
 
+MBC3::~MBC3()
+{
+    // keep the time the clock stopped at
+    if (rtc_started_) {
+        write_rtc_footer_();
+    }
+}
+
+void MBC3::set_rtc_clock(CPU* cpu)
+{
+    /* switching the time source keeps the counter where it is */
+    if (!rtc_started_) {
+        rtc_cpu_ = cpu;
+        return;
+    }
+    double counter = counter_();
+    rtc_cpu_ = cpu;
+    set_counter_(counter);
+}
+
+double MBC3::now_()
+{
+    if (rtc_cpu_) {
+        return rtc_cpu_->cycle_count() / 4194304.0;
+    }
+    return std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+double MBC3::counter_()
+{
+    start_rtc_();
+    return rtc_halted_ ? rtc_halted_counter_ : now_() - rtc_base_;
+}
+
+void MBC3::set_counter_(double seconds)
+{
+    if (rtc_halted_) {
+        rtc_halted_counter_ = seconds;
+    }
+    else {
+        rtc_base_ = now_() - seconds;
+    }
+}
+
+static uint32_t read_footer_value(const uint8_t* footer, int index)
+{
+    return footer[4 * index] | (footer[4 * index + 1] << 8) | (footer[4 * index + 2] << 16) | (static_cast<uint32_t>(footer[4 * index + 3]) << 24);
+}
+
+static void write_footer_value(uint8_t* footer, int index, uint32_t value)
+{
+    for (int byte = 0; byte < 4; byte++) {
+        footer[4 * index + byte] = value >> (8 * byte);
+    }
+}
+
+void MBC3::start_rtc_()
+{
+    /* The clock starts at 0 on a new cartridge, and from the registers in the footer (saved at its UNIX time) otherwise */
+    if (rtc_started_) {
+        return;
+    }
+    rtc_started_ = true;
+
+    double counter = 0;
+    const uint8_t* footer = external_ram_->footer();
+    uint64_t saved_at = 0;
+    if (has_rtc_) {
+        for (int byte = 0; byte < 8; byte++) {
+            saved_at |= static_cast<uint64_t>(footer[40 + byte]) << (8 * byte);
+        }
+    }
+    if (saved_at != 0) {
+        uint32_t days = (read_footer_value(footer, 3) & 0xff) | ((read_footer_value(footer, 4) & 0x01) << 8);
+        counter = read_footer_value(footer, 0) + read_footer_value(footer, 1) * 60 + read_footer_value(footer, 2) * 3600 + days * 86400.0;
+        rtc_halted_ = read_footer_value(footer, 4) & 0x40;
+        rtc_carry_ = read_footer_value(footer, 4) & 0x80;
+        rtc_s = read_footer_value(footer, 5);
+        rtc_m = read_footer_value(footer, 6);
+        rtc_h = read_footer_value(footer, 7);
+        rtc_dl = read_footer_value(footer, 8);
+        rtc_dh = read_footer_value(footer, 9);
+
+        // the clock kept running while the emulator was not (on the host clock only, the emulated one did not run)
+        double now = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+        if (!rtc_cpu_ && !rtc_halted_ && now > saved_at) {
+            counter += now - saved_at;
+        }
+    }
+    set_counter_(counter);
+}
 
 void MBC3::latch_clock()
 {
-    // TODO: implement timer feature
+    /* Compute the registers from the counter. The day counter has 9 bits: when it overflows the carry flag is set, and
+    the counter continues from day 0 */
+    double counter = counter_();
+    uint64_t days = static_cast<uint64_t>(counter) / 86400;
+    if (days >= 512) {
+        rtc_carry_ = true;
+        counter -= (days / 512) * 512 * 86400.0;
+        set_counter_(counter);
+        days %= 512;
+    }
+    uint64_t seconds = static_cast<uint64_t>(counter);
+    rtc_s = seconds % 60;
+    rtc_m = (seconds / 60) % 60;
+    rtc_h = (seconds / 3600) % 24;
+    rtc_dl = days & 0xff;
+    rtc_dh = (days >> 8) | (rtc_halted_ << 6) | (rtc_carry_ << 7);
+}
+
+void MBC3::write_rtc_(uint8_t reg, uint8_t value)
+{
+    /* Replace one field of the counter. Writing the seconds also restarts the current second */
+    double counter = counter_();
+    uint64_t whole = static_cast<uint64_t>(counter);
+    double fraction = counter - whole;
+    uint64_t seconds = whole % 60;
+    uint64_t minutes = (whole / 60) % 60;
+    uint64_t hours = (whole / 3600) % 24;
+    uint64_t days = (whole / 86400) % 512;
+
+    switch (reg) {
+        case 0x8:
+            seconds = value & 0x3f;
+            fraction = 0;
+            rtc_s = value & 0x3f;
+            break;
+        case 0x9:
+            minutes = value & 0x3f;
+            rtc_m = value & 0x3f;
+            break;
+        case 0xa:
+            hours = value & 0x1f;
+            rtc_h = value & 0x1f;
+            break;
+        case 0xb:
+            days = (days & 0x100) | value;
+            rtc_dl = value;
+            break;
+        case 0xc:
+            days = (days & 0xff) | ((value & 0x01) << 8);
+            rtc_carry_ = value & 0x80;
+            rtc_dh = value & 0xc1;
+            break;
+    }
+    counter = seconds + minutes * 60 + hours * 3600 + days * 86400 + fraction;
+
+    bool halted = reg == 0xc ? (value & 0x40) : rtc_halted_;
+    if (halted != rtc_halted_) {
+        // stop the counter where it is, or start it again from there
+        rtc_halted_ = halted;
+        if (halted) {
+            rtc_halted_counter_ = counter;
+        }
+        else {
+            rtc_base_ = now_() - counter;
+        }
+    }
+    else {
+        set_counter_(counter);
+    }
+
+    if (has_rtc_) {
+        write_rtc_footer_();
+    }
+}
+
+void MBC3::write_rtc_footer_()
+{
+    /* the current registers, the latched ones, and the UNIX time (the current registers are recomputed from it on load) */
+    uint8_t* footer = external_ram_->footer();
+    double counter = counter_();
+    uint64_t seconds = static_cast<uint64_t>(counter);
+    uint64_t days = (seconds / 86400) % 512;
+    write_footer_value(footer, 0, seconds % 60);
+    write_footer_value(footer, 1, (seconds / 60) % 60);
+    write_footer_value(footer, 2, (seconds / 3600) % 24);
+    write_footer_value(footer, 3, days & 0xff);
+    write_footer_value(footer, 4, (days >> 8) | (rtc_halted_ << 6) | (rtc_carry_ << 7));
+    write_footer_value(footer, 5, rtc_s);
+    write_footer_value(footer, 6, rtc_m);
+    write_footer_value(footer, 7, rtc_h);
+    write_footer_value(footer, 8, rtc_dl);
+    write_footer_value(footer, 9, rtc_dh);
+
+    uint64_t now = static_cast<uint64_t>(std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count());
+    for (int byte = 0; byte < 8; byte++) {
+        footer[40 + byte] = now >> (8 * byte);
+    }
+    external_ram_->mark_dirty();
 }
\ No newline at end of file
@@ -0,0 +1,64 @@
+#include "movie.h"
+#include "joypad.h"
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+void Movie::load_movie_from_file(std::string movie_file)
+{
+    /* Read the input changes from the movie file at the path movie_file */
+    std::ifstream movie_reader(movie_file);
+
+    if (!movie_reader) {
+        throw std::runtime_error("could not open the movie file " + movie_file + ".");
+    }
+
+    const std::unordered_map<std::string, uint8_t> button_names = {
+        {"RIGHT", Joypad::Right}, {"LEFT", Joypad::Left}, {"UP", Joypad::Up}, {"DOWN", Joypad::Down},
+        {"A", Joypad::A}, {"B", Joypad::B}, {"SELECT", Joypad::Select}, {"START", Joypad::Start}
+    };
+
+    std::string line;
+    while (std::getline(movie_reader, line)) {
+        // skip comments and empty lines
+        line = line.substr(0, line.find('#'));
+        std::stringstream fields(line);
+        uint64_t frame;
+        std::string buttons;
+        if (!(fields >> frame)) {
+            continue;
+        }
+        fields >> buttons;
+
+        uint8_t pressed = 0;
+        std::stringstream names(buttons);
+        std::string name;
+        while (std::getline(names, name, ',')) {
+            if (name.empty() || name == "-") {
+                continue;
+            }
+            if (!button_names.contains(name)) {
+                throw std::runtime_error("unknown button " + name + " in the movie file " + movie_file + ".");
+            }
+            pressed |= button_names.at(name);
+        }
+        changes_.push_back({frame, pressed});
+    }
+
+    std::stable_sort(changes_.begin(), changes_.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+}
+
+uint8_t Movie::input_for_frame(uint64_t frame)
+{
+    // find the last change at or before this frame
+    auto next = std::upper_bound(changes_.begin(), changes_.end(), frame, [](uint64_t f, const auto& change) { return f < change.first; });
+    if (next == changes_.begin()) {
+        return 0;
+    }
+    return std::prev(next)->second;
+}
\ No newline at end of file
@@ -0,0 +1,222 @@
+#include "perf_counters.h"
+#include <iomanip>
+#include <iostream>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static const char* counter_names[] = {"cycles", "instructions", "branch-misses", "L1-icache-misses", "L1-dcache-misses", "LLC-misses"};
+static const char* region_names[] = {"frame", "cpu (sampled)", "render", "present"};
+
+#ifdef __linux__
+
+PerfCounters::PerfCounters()
+{
+    auto cache_miss = [](uint64_t cache) { return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16); };
+    const std::array<std::pair<uint32_t, uint64_t>, counter_count> events = {{
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+        {PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_L1I)},
+        {PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_L1D)},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    }};
+
+    // the counters are opened one by one (not as a group), so one the CPU does not support does not take the others with it
+    available_ = false;
+    for (int counter = 0; counter < counter_count; counter++) {
+        perf_event_attr attr {};
+        attr.size = sizeof(attr);
+        attr.type = events[counter].first;
+        attr.config = events[counter].second;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        fds_[counter] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (fds_[counter] < 0) {
+            continue;
+        }
+        available_ = true;
+
+        // map the counter's page, so it can be read with rdpmc instead of a system call
+        void* page = mmap(nullptr, sysconf(_SC_PAGESIZE), PROT_READ, MAP_SHARED, fds_[counter], 0);
+        pages_[counter] = page == MAP_FAILED ? nullptr : page;
+    }
+
+    if (available_) {
+        calibrate_();
+    }
+}
+
+PerfCounters::~PerfCounters()
+{
+    for (int counter = 0; counter < counter_count; counter++) {
+        if (pages_[counter]) {
+            munmap(pages_[counter], sysconf(_SC_PAGESIZE));
+        }
+        if (fds_[counter] >= 0) {
+            close(fds_[counter]);
+        }
+    }
+}
+
+uint64_t PerfCounters::read_counter_(int counter)
+{
+    if (fds_[counter] < 0) {
+        return 0;
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    // user space read, following the protocol in linux/perf_event.h: retry if the kernel updated the page meanwhile
+    if (volatile perf_event_mmap_page* page = static_cast<perf_event_mmap_page*>(pages_[counter])) {
+        uint32_t sequence, index;
+        int64_t count;
+        do {
+            sequence = page->lock;
+            asm volatile("" ::: "memory");
+            index = page->index;
+            count = page->offset;
+            if (page->cap_user_rdpmc && index) {
+                uint32_t low, high;
+                asm volatile("rdpmc" : "=a"(low), "=d"(high) : "c"(index - 1));
+                int64_t pmc = (static_cast<uint64_t>(high) << 32) | low;
+                // sign extend the counter from its width
+                pmc <<= 64 - page->pmc_width;
+                pmc >>= 64 - page->pmc_width;
+                count += pmc;
+            }
+            asm volatile("" ::: "memory");
+        } while (page->lock != sequence);
+
+        if (page->cap_user_rdpmc && index) {
+            return count;
+        }
+    }
+#endif
+
+    // the counter is not on the PMU right now (or rdpmc is not allowed): ask the kernel
+    uint64_t count = 0;
+    if (read(fds_[counter], &count, sizeof(count)) != sizeof(count)) {
+        return 0;
+    }
+    return count;
+}
+
+#else
+
+PerfCounters::PerfCounters()
+{
+    fds_.fill(-1);
+}
+
+PerfCounters::~PerfCounters()
+{
+}
+
+uint64_t PerfCounters::read_counter_(int counter)
+{
+    return 0;
+}
+
+#endif
+
+void PerfCounters::read_(Counts& counts)
+{
+    for (int counter = 0; counter < counter_count; counter++) {
+        counts[counter] = read_counter_(counter);
+    }
+}
+
+void PerfCounters::calibrate_()
+{
+    /* the average of many empty measurements: the sampled regions are only meaningful on average too */
+    const int measurements = 1000;
+    Counts sum {};
+    for (int i = 0; i < measurements; i++) {
+        Counts start, end;
+        read_(start);
+        read_(end);
+        for (int counter = 0; counter < counter_count; counter++) {
+            sum[counter] += end[counter] - start[counter];
+        }
+    }
+    for (int counter = 0; counter < counter_count; counter++) {
+        overhead_[counter] = sum[counter] / measurements;
+    }
+}
+
+void PerfCounters::end(Region region, uint64_t scale)
+{
+    if (!available_) {
+        return;
+    }
+    Counts now;
+    read_(now);
+    for (int counter = 0; counter < counter_count; counter++) {
+        uint64_t count = now[counter] - start_[region][counter];
+        count = count > overhead_[counter] ? count - overhead_[counter] : 0;
+        totals_[region][counter] += count * scale;
+    }
+    calls_[region]++;
+}
+
+void PerfCounters::add(Region region, const PerfCounters& other)
+{
+    for (int counter = 0; counter < counter_count; counter++) {
+        totals_[region][counter] += other.totals_[region][counter];
+    }
+    calls_[region] += other.calls_[region];
+}
+
+void PerfCounters::write_report(std::ostream& out)
+{
+    if (!available_) {
+        out << "Hardware performance counters are not available (see /proc/sys/kernel/perf_event_paranoid)." << std::endl;
+        return;
+    }
+
+    out << "Hardware performance counters";
+    if (emulated_instructions_ > 0) {
+        out << " (" << emulated_instructions_ << " emulated instructions)";
+    }
+    out << ":\n" << std::setw(16) << "region";
+    for (const char* name : counter_names) {
+        out << std::setw(18) << name;
+    }
+    out << std::setw(8) << "IPC" << "\n";
+
+    for (int region = 0; region < region_count; region++) {
+        if (calls_[region] == 0) {
+            continue;
+        }
+        const Counts& counts = totals_[region];
+        out << std::setw(16) << region_names[region];
+        for (int counter = 0; counter < counter_count; counter++) {
+            if (fds_[counter] < 0) {
+                out << std::setw(18) << "n/a";
+            }
+            else {
+                out << std::setw(18) << counts[counter];
+            }
+        }
+        double ipc = counts[Cycles] ? static_cast<double>(counts[Instructions]) / counts[Cycles] : 0;
+        out << std::setw(8) << std::fixed << std::setprecision(2) << ipc << "\n";
+    }
+
+    if (emulated_instructions_ > 0 && calls_[Frame] > 0) {
+        // normalise the frame totals by the work done, so runs of different lengths compare
+        out << "\nPer emulated instruction (frame):\n";
+        for (int counter = 0; counter < counter_count; counter++) {
+            if (fds_[counter] >= 0) {
+                out << std::setw(18) << counter_names[counter] << std::setw(12) << std::setprecision(3)
+                    << static_cast<double>(totals_[Frame][counter]) / emulated_instructions_ << "\n";
+            }
+        }
+    }
+    out << std::flush;
+}
\ No newline at end of file
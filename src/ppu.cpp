@@ -1,10 +1,4 @@
-#include <SDL2/SDL.h>
-#include <SDL_error.h>
-#include <SDL_hints.h>
-#include <SDL_pixels.h>
-#include <SDL_render.h>
-#include <SDL_surface.h>
-#include <SDL_video.h>
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <iostream>
@@ -14,58 +8,21 @@
 
 #include "ppu.h"
 #include "bus.h"
+#include "hash.h"
+#include "perf_counters.h"
+#include "raster.h"
+#include "timeline.h"
 
 PPU::PPU() 
 {
-    // initialize SDL 
-    if (SDL_Init(SDL_INIT_VIDEO) != 0) {
-        std::cout << "Error: " << SDL_GetError();
-        exit(-1);
-    }
-
-    int scale = 4;
-    // create a window, renderer and texture
-    window_ = SDL_CreateWindow("GameBoy 1989", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, scale * SCREEN_WIDTH, scale * SCREEN_HEIGHT, SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE);
-    if (!window_) {
-        std::cout << "Failed to create window: " << SDL_GetError();
-        exit(-1);
-    }
-
-    SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "nearest");
-
-    renderer_ = SDL_CreateRenderer(window_, -1, SDL_RENDERER_ACCELERATED);
-    if (!renderer_) {
-        std::cout << "Failed to create renderer: " << SDL_GetError();
-        exit(-1);
-    }
-
-    texture_ = SDL_CreateTexture(renderer_, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, SCREEN_WIDTH, SCREEN_HEIGHT);
-    if (!texture_) {
-        std::cout << "Failed to create texture: " << SDL_GetError();
-    }
-
-    // initialize the texture to white
-    SDL_SetRenderTarget(renderer_, texture_);
-    SDL_SetRenderDrawColor(renderer_, 255, 255, 255, SDL_ALPHA_OPAQUE);
-    SDL_RenderClear(renderer_);
-    SDL_SetRenderTarget(renderer_, NULL);
-
-
     // start the OAM with 0s
     oam_.fill(0);
-    frame_background_colour.fill(0);
+    // the LCD starts switched off, showing a white screen
+    framebuffer_.fill(LCD_OFF_SHADE);
+    completed_frame_.fill(LCD_OFF_SHADE);
 }
 
 PPU::~PPU() {
-    // destructor - exit out of SDL, and destroy all allocated resources
-    SDL_DestroyTexture(texture_);
-    SDL_DestroyRenderer(renderer_);
-    SDL_DestroyWindow(window_);
-}
-
-void PPU::display_frame_rate(float frame_rate)
-{
-    SDL_SetWindowTitle(window_, std::to_string(frame_rate).c_str());
 }
 
 void PPU::connect_bus(Bus* bus) 
@@ -73,20 +30,38 @@ void PPU::connect_bus(Bus* bus)
     bus_ = bus;
 }
 
-void PPU::clear_screen() {
-    // set the screen to black
-    SDL_SetRenderTarget(renderer_, NULL);
-    SDL_SetRenderDrawColor(renderer_, 0, 0, 0, SDL_ALPHA_OPAQUE);
-    SDL_RenderClear(renderer_);
+void PPU::connect_interrupts(InterruptController* interrupts)
+{
+    interrupts_ = interrupts;
 }
 
-void PPU::render() {
-    // copy the texture to the screen, then update the window
-    SDL_SetRenderTarget(renderer_, NULL);
-    SDL_RenderCopy(renderer_, texture_, NULL, NULL);
-    SDL_RenderPresent(renderer_);
-    // get ready for drawing the next frame to the texture
-    SDL_SetRenderTarget(renderer_, texture_);
+void PPU::finish_frame()
+{
+    /* A frame has been completed (VBlank started, or the LCD was switched off): hash it, so that every frame can be compared
+       against golden runs. XXH64 over the 23040 byte framebuffer takes a few microseconds, far below 1% of a 16.7 ms frame.
+       With the deferred renderer the frame is only drawn now */
+    frame_count_++;
+    collect_frame_();
+    frame_rendered_ = lines_drawn_ == SCREEN_HEIGHT;
+    lines_drawn_ = 0;
+    if (!frame_rendered_) {
+        // lines were skipped (see set_rendering): the last complete frame stays
+        logs_[log_].clear();
+        return;
+    }
+    if (!logs_[log_].lines.empty()) {
+        // the rasterizer draws the logged lines while the next frame is emulated, the frame is completed once it is asked for
+        // (or at the next one)
+        rasterizer_->start(&logs_[log_], framebuffer_.data());
+        rasterizing_ = true;
+        rasterizing_number_ = frame_count_;
+        log_ ^= 1;
+        logs_[log_].clear();
+        return;
+    }
+    completed_frame_ = framebuffer_;
+    frame_hash_ = hash::xxh64(completed_frame_.data(), completed_frame_.size());
+    completed_number_ = frame_count_;
 }
 
 uint8_t PPU::read(uint16_t address)
@@ -101,6 +76,7 @@ uint8_t PPU::read(uint16_t address)
     else if (address >= 0xfe00 && address <= 0xfe9f) {
         // the cpu can only directly read from the OAM during HBlank or VBlank or if the LCD and PPU are off
         if (stat_.ppu_mode_ == 0 || stat_.ppu_mode_ == 1 || lcdc_.lcdc_enable_ == 0) {
+            finish_oam_dma();
             return oam_[address - 0xfe00];
         }
     }
@@ -145,11 +121,17 @@ void PPU::write(uint16_t address, uint8_t value)
         // the cpu can only write to VRAM if the mode is not 3, otherwise ignore write
         if (stat_.ppu_mode_ != 3) {
             vram_[address - 0x8000] = value;
+            // lines already logged this frame are drawn with VRAM as it was
+            FrameLog& log = logs_[log_];
+            if (!log.lines.empty()) {
+                log.journal.push_back({static_cast<uint16_t>(address - 0x8000), value, static_cast<uint8_t>(log.lines.size())});
+            }
         }
     }
     else if (address >= 0xfe00 && address <= 0xfe9f) {
         // the cpu can only directly write to the OAM during HBlank or VBlank, otherwise ignore write
         if (stat_.ppu_mode_ == 0 || stat_.ppu_mode_ == 1) {
+            finish_oam_dma();
             oam_[address - 0xfe00] = value;
         }
     }
@@ -157,10 +139,17 @@ void PPU::write(uint16_t address, uint8_t value)
         // writing to a register
         switch (address) {
             case 0xff40:
-                lcdc_.set(value);
+                {
+                    uint8_t lcd_enable = lcdc_.lcdc_enable_;
+                    lcdc_.set(value);
+                    if (lcdc_.lcdc_enable_ != lcd_enable) {
+                        switch_lcd_();
+                    }
+                }
                 break;
             case 0xff41:
                 stat_.set(value);
+                update_stat_line_();
                 break;
             case 0xff42:
                 scy_ = value;
@@ -170,12 +159,8 @@ void PPU::write(uint16_t address, uint8_t value)
                 break;
             case 0xff45:
                 lyc_ = value;
-                break;
-            case 0xff46:
-                dma_source_ = value;
-                // TODO: the OAM DMA transfer will happen instantaneously. However, in reality,
-                // this should take 160 M cycles, and CPU access, PPU access should be restricted
-                oam_dma_transfer(value);
+                compare_lyc_();
+                update_stat_line_();
                 break;
             case 0xff47:
                 bgp_ = value;
@@ -199,170 +184,266 @@ void PPU::write(uint16_t address, uint8_t value)
 
 void PPU::set_mode(uint8_t mode) 
 {
-        if (stat_.set_mode(mode)) {
-            // set mode indicated that the STAT interrupt should be executed; make the request manually
-            uint8_t interrupt_flag = bus_->read(0xff0f);
-            interrupt_flag |= (1 << 1); // update the LCD / STAT flag in IF
-            bus_->write(0xff0f, interrupt_flag); 
+        if (Timeline* timeline = bus_->timeline()) {
+            static const char* mode_names[] = {"HBlank", "VBlank", "OAM scan", "Drawing"};
+            timeline->state(Timeline::PPU, lcdc_.lcdc_enable_ ? mode_names[mode] : "LCD off");
         }
+        stat_.set_mode(mode);
+}
+
+void PPU::compare_lyc_()
+{
+    stat_.set_lyc_equals(ly_, lyc_);
 }
 
+void PPU::update_stat_line_()
+{
+    /* The STAT interrupt is requested when the OR of its enabled sources goes from low to high: while one source holds
+    the line high, another one becoming true does not request it again (STAT blocking) */
+    uint8_t mode = stat_.ppu_mode_;
+    bool line = (stat_.lyc_select && stat_.lyc_equals) || (stat_.mode0_select && mode == 0) || (stat_.mode1_select && mode == 1) ||
+        (stat_.mode2_select && mode == 2);
+    if (line && !stat_line_) {
+        interrupts_->request(InterruptController::LCD);
+    }
+    stat_line_ = line;
+}
 
-void PPU::cycle()
+void PPU::schedule_(uint32_t cycles)
 {
-    /* Run through one cycle of the PPU. This processes 1 dot, and switches between the 4 possible PPU modes. Each PPU mode takes a certain number of cycles
-    to complete (t-cycles, which are controlled by the master clock also counting the CPU cycles) */
+    cycles_to_event_ = cycles;
+    mode_length_ = cycles;
+}
 
-    /* TODO: implement mode 3 variable timing */
+void PPU::event_()
+{
+    /* The current mode has ended: switch to the next one, and schedule its end. Each mode lasts a whole number of cycles
+    (t-cycles, which are controlled by the master clock also counting the CPU cycles), and LY only changes here, so this
+    is also where LY == LYC is compared */
+
+    if (!lcdc_.lcdc_enable_) {
+        // the LCD is off: nothing happens until it is switched on again
+        schedule_(UINT32_MAX);
+        return;
+    }
 
-    // check if the mode is "over", and therefore we need to switch
-    if (lcdc_.lcdc_enable_) {
-        // only process cycles on the PPU if the LCD is enabled
-        if (t_cycles_delay_ == 0) {
-
-            // constantly update the LY == LYC flag, and check if a stat interrupt needs to be requested
-            if (stat_.set_lyc_equals(ly_, lyc_)) {
-                uint8_t interrupt_flag = bus_->read(0xff0f);
-                interrupt_flag |= (1 << 1); // update the LCD / STAT flag in IF
-                bus_->write(0xff0f, interrupt_flag); 
+    switch (stat_.ppu_mode_) {
+        case 0:
+            // Switch from HBlank to OAM scan or to VBlank depending on the scanline number
+            // reaching the end of mode 0 is always the indication of the next scanline
+            ly_++;
+            if (ly_ == 144) {
+                // scanlines 144 - 153 are mode 1
+                set_mode(1); 
+                schedule_(456); // execute for 1 scanline 
+                interrupts_->request(InterruptController::VBlank);
+                // the frame is complete
+                finish_frame();
             }
-
-            switch (stat_.ppu_mode_) {
-                case 0:
-                    // Switch from HBlank to OAM scan or to VBlank depending on the scanline number
-                    {
-                        // if we reach this point, we are in mode 0, and have currently finished the scanline.
-                        // if we just finished the scanline, and are currently on scanline 143, scanlines 144 - 153 are mode 1 -> the next mode should be VBlank
-                        if (ly_ == 143) {
-                            set_mode(1); 
-                            t_cycles_delay_ += 456; // execute for 1 scanline 
-                            // create a VBlank interrupt request 
-                            uint8_t interrupt_flag = bus_->read(0xff0f);
-                            interrupt_flag |= (1 << 0); // update the timer flag IF
-                            bus_->write(0xff0f, interrupt_flag); 
-                            // reaching the end of mode 0 is always the indication of the next scanline
-                            ly_++;
-                        }
-                        else {
-                            set_mode(2);
-                            ly_++;
-                            oam_scan();
-                            t_cycles_delay_ += 80;
-                        }
-                    } 
-                    break;
-                case 1:
-                    //  switch from VBlank to OAM scan if in the last scanline of the frame, otherwise remain in VBlank
-                    {
-                        if (ly_ == 153) {
-                            // we just finished the last scanline, so loop back to the first scanline 
-                            set_mode(2);
-                            t_cycles_delay_ += 80;
-                            ly_ = 0;
-                            oam_scan();
-                        }
-                        else {
-                            // we remain in mode 1, and progress the scanline
-                            set_mode(1);
-                            t_cycles_delay_ += 456;
-                            ly_++;
-                        }
-                    }
-                    break;
-                case 2:
-                    // switch from OAM scan to drawing
-                    set_mode(3);
-                    // test_draw_vram();
-                    draw_scanline();
-                    t_cycles_delay_ += 172; // MODE 3 has a variable length, for now keep it at the maximum length
-                    break;
-                case 3:
-                    // switch from drawing pixels to HBlank
-                    set_mode(0);
-                    t_cycles_delay_ += 204; // MODE 0 has a variable length, depending on MODE 3 length (based on (376 - MODE 3 Duration))
-                    break;
+            else {
+                set_mode(2);
+                oam_scan();
+                schedule_(80);
             }
-            
-        }
+            compare_lyc_();
+            break;
+        case 1:
+            //  switch from VBlank to OAM scan if in the last scanline of the frame, otherwise remain in VBlank
+            if (ly_ == 153) {
+                // we just finished the last scanline, so loop back to the first scanline 
+                ly_ = 0;
+                window_line_ = 0;
+                set_mode(2);
+                oam_scan();
+                schedule_(80);
+            }
+            else {
+                ly_++;
+                schedule_(456);
+            }
+            compare_lyc_();
+            break;
+        case 2:
+            // switch from OAM scan to drawing
+            set_mode(3);
+            window_drawn_ = false;
+            if (ly_ == 0) {
+                rendering_ = render_;
+            }
+            if (renderer_ == Renderer::PixelFifo) {
+                // the line is drawn by one event per dot, until its last pixel is out
+                lines_drawn_++;
+                fifo_start_line_();
+                drawing_ = 0;
+                fifo_render_dot_();
+                drawing_ = 1;
+                schedule_(1);
+                break;
+            }
+            if (!rendering_) {
+                // only the window's line counter is kept
+                window_drawn_ = window_visible_on_line_();
+            }
+            else if (perf_counters_) {
+                perf_counters_->begin(PerfCounters::Render);
+                draw_scanline();
+                perf_counters_->end(PerfCounters::Render);
+            }
+            else {
+                draw_scanline();
+            }
+            drawing_ = drawing_length_();
+            schedule_(drawing_);
+            break;
+        case 3:
+            if (fifo_.drawing) {
+                fifo_render_dot_();
+                drawing_++;
+                schedule_(1);
+                return; // nothing the STAT line looks at changed
+            }
+            // switch from drawing pixels to HBlank
+            set_mode(0);
+            if (window_drawn_) {
+                window_line_++;
+            }
+            schedule_(376 - drawing_); // the rest of the line after mode 2 and 3
+            break;
+    }
+    update_stat_line_();
+}
+
+uint32_t PPU::drawing_length_()
+{
+    /* Mode 3 takes 172 dots, plus (as the pixel FIFO would stall, Pan Docs "Mode 3 length"):
+        - SCX % 8, for the pixels of the first background tile that are fetched and discarded
+        - 6 if the window is drawn on this line, for the fetcher restarting on the window's tiles
+        - the stall of every object on the line (see object_stall_) */
+    uint32_t length = 172 + scx_ % 8;
+    bool window = window_visible_on_line_();
+    if (window) {
+        length += 6;
+    }
+    if (!lcdc_.obj_enable || scanline_sprites_.empty()) {
+        return length;
+    }
 
-        if (t_cycles_delay_ > 0) {
-            t_cycles_delay_--; 
+    // the objects are fetched from left to right
+    std::array<uint8_t, 10> xs;
+    size_t count = 0;
+    for (int sprite : scanline_sprites_) {
+        if (oam_[sprite + 1] < 168) { // objects right of the screen are not fetched
+            xs[count++] = oam_[sprite + 1];
         }
     }
+    std::sort(xs.begin(), xs.begin() + count);
+
+    uint64_t waited = 0;
+    for (size_t i = 0; i < count; i++) {
+        length += object_stall_(xs[i], window && xs[i] - 8 >= wx_ - 7, waited);
+    }
+    return length;
+}
+
+uint32_t PPU::object_stall_(uint8_t x, bool window, uint64_t& waited)
+{
+    /* The dots an object at X stalls the pixel FIFO for: 6 for its fetch, plus the wait for the background (or window)
+    tile under its leftmost pixel to be fetched: 5 - the pixel's position in that tile, if positive, once per tile (the
+    leftmost object on it waits). An object at X = 0 always waits the longest, 5. waited has a bit for each tile already
+    waited for: the 32 background tiles, then the window's */
+    if (x == 0) {
+        return 11;
+    }
+    int pixel = x - 8; // the object's leftmost pixel on the screen
+    int tile;
+    int position;
+    if (window) {
+        tile = 32 + (pixel - (wx_ - 7)) / 8;
+        position = (pixel - (wx_ - 7)) % 8;
+    }
+    else {
+        uint8_t x_coordinate = scx_ + pixel;
+        tile = x_coordinate / 8;
+        position = x_coordinate % 8;
+    }
+    if (waited & (1ull << tile)) {
+        return 6;
+    }
+    waited |= 1ull << tile;
+    return 6 + std::max(5 - position, 0);
+}
+
+void PPU::switch_lcd_()
+{
+    /* Switching the LCD on starts the first line with its OAM scan, switching it off resets LY and blanks the screen to
+    white. Either way the PPU is rescheduled once, here */
+    ly_ = 0;
+    window_line_ = 0;
+    lines_drawn_ = 0;
+    if (lcdc_.lcdc_enable_) {
+        set_mode(2);
+        oam_scan();
+        schedule_(80);
+    }
     else {
-        // SWITCH OFF LCD: clear the screen to blank white
+        set_mode(0);
+        schedule_(UINT32_MAX);
+        fifo_.drawing = false;
+        lcd_off_at_ = bus_->cycle_count();
+        collect_frame_();
+        logs_[log_].clear(); // the lines of the unfinished frame are blanked anyway
         if (!screen_cleared_) {
-            SDL_SetRenderTarget(renderer_, texture_);
-            SDL_SetRenderDrawColor(renderer_, 255, 255, 255, SDL_ALPHA_OPAQUE);
-            SDL_RenderClear(renderer_);
+            framebuffer_.fill(LCD_OFF_SHADE);
             screen_cleared_ = true;
+            lines_drawn_ = SCREEN_HEIGHT; // the blank frame is complete
+            finish_frame();
         }
-        ly_ = 0;
-        set_mode(0);
     }
+    compare_lyc_();
+    update_stat_line_();
 }
 
-
-void PPU::set_colour_from_palette(int* r, int* g, int* b, uint8_t colour_ID, uint8_t palette)
+uint32_t PPU::idle_cycles()
 {
-    /* Given a colour ID, set the r, g, b values by using the PPU's palette */
-
-    // based on the colour ID, take a look at the bits of the palette corresponding to the ID
-    uint8_t colour_value;
+    /* cycle() only changes something at an event (every interrupt the PPU requests is requested there), and nothing at all
+    while the LCD is off */
+    if (lcdc_.lcdc_enable_) {
+        return cycles_to_event_ - 1;
+    }
+    return UINT32_MAX; // the LCD stays off until the CPU writes LCDC
+}
 
-    switch(colour_ID) {
-        case 0:
-            // look at bits 0, 1
-            colour_value = (palette & 0b00000011) >> 0;
-            break;
-        case 1:
-            // look at bits 2, 3
-            colour_value = (palette & 0b00001100) >> 2;
-            break;
-        case 2:
-            // look at bits 4, 5
-            colour_value = (palette & 0b00110000) >> 4;
-            break;
-        case 3:
-            // look at bits 6, 7
-            colour_value = (palette & 0b11000000) >> 6;
-            break;
+uint32_t PPU::quiet_cycles()
+{
+    if (lcdc_.lcdc_enable_) {
+        return mode_length_ - cycles_to_event_;
     }
+    // switching the LCD off changed LY and STAT
+    uint64_t off_for = bus_->cycle_count() - lcd_off_at_;
+    return off_for < UINT32_MAX ? static_cast<uint32_t>(off_for) : UINT32_MAX;
+}
 
-    switch (colour_value) {
-        case 0:
-            // set the colour to near-white
-            *r = 242;        
-            *g = 242;
-            *b = 242;
-            break;
-        case 1:
-            // set the colour to light gray 
-            *r = 191;        
-            *g = 191;
-            *b = 191;
-            break;
-        case 2:
-            // set the colour to dark gray 
-            *r = 115;        
-            *g = 115;
-            *b = 115;
-            break;
-        case 3:
-            // set the colour to black 
-            *r = 0;        
-            *g = 0;
-            *b = 0;
-            break;
+void PPU::skip(uint32_t cycles)
+{
+    if (lcdc_.lcdc_enable_) {
+        cycles_to_event_ -= cycles;
     }
 }
 
+uint8_t PPU::get_shade_from_palette(uint8_t colour_ID, uint8_t palette)
+{
+    /* Given a colour ID, find the shade (0 = near-white, 1 = light gray, 2 = dark gray, 3 = black) using the PPU's palette */
+
+    // based on the colour ID, take a look at the bits of the palette corresponding to the ID:
+    // bits 0, 1 for ID 0, bits 2, 3 for ID 1, bits 4, 5 for ID 2 and bits 6, 7 for ID 3
+    return (palette >> (colour_ID * 2)) & 0b11;
+}
+
 void PPU::test_draw_vram()
 {
     /* Test function. Draw out the whole tilemap in the first section (for drawing Nintendo logo tiles) */
 
     uint16_t tile_data_area = 0x8000;
-    int r = 0; int g = 0; int b = 0;
 
     for (int y = 0; y <= SCREEN_HEIGHT - 8; y += 8) {
         for (int x = 0; x <= SCREEN_WIDTH - 8; x += 8) {
@@ -373,9 +454,7 @@ void PPU::test_draw_vram()
                 uint8_t byte2 = vram_[(tile_data_area + 1) - 0x8000];
                 // draw the row
                 for (int j = 0; j < 8; j++) {
-                    set_colour_from_palette(&r, &g, &b, ((byte1 & (1 << (7 - j))) >> (7 - j)) + (((byte2 & (1 << (7 - j))) >> (7 - j)) << 1), bgp_);
-                    SDL_SetRenderDrawColor(renderer_, r, g, b, SDL_ALPHA_OPAQUE);
-                    SDL_RenderDrawPoint(renderer_, x + j, y + i);
+                    framebuffer_[(y + i) * SCREEN_WIDTH + (x + j)] = get_shade_from_palette(((byte1 & (1 << (7 - j))) >> (7 - j)) + (((byte2 & (1 << (7 - j))) >> (7 - j)) << 1), bgp_);
                 }
                 // after drawing the row, fetch the next two bytes 
                 tile_data_area += 2;
@@ -385,14 +464,46 @@ void PPU::test_draw_vram()
     
 }
 
-void PPU::oam_dma_transfer(uint8_t value)
+void PPU::start_oam_dma(uint8_t source, uint64_t cycle)
+{
+    /* Schedule a transfer from <source> * 0x100 to OAM. If one is still running it stops here, with the bytes it
+    copied so far (one per m-cycle) in OAM, and the CPU stays cut off without a gap */
+    bool running = dma_pending_ && cycle < dma_end_;
+    if (running) {
+        copy_oam_dma_(cycle > dma_start_ ? static_cast<int>((cycle - dma_start_) / 4) : 0);
+        dma_pending_ = false;
+    }
+    finish_oam_dma();
+
+    dma_source_ = source;
+    dma_pending_ = true;
+    dma_start_ = cycle + 4;
+    dma_end_ = dma_start_ + 160 * 4;
+    if (!running) {
+        dma_blocked_from_ = dma_start_;
+    }
+}
+
+bool PPU::finish_oam_dma()
 {
-   /*  When requested, perform a transfer from ROM or RAM to OAM. <value> specifies the 
-        transfer source address divided by 0x100 */
+    if (dma_pending_ && bus_->cycle_count() >= dma_end_) {
+        copy_oam_dma_(160);
+        dma_pending_ = false;
+    }
+    return !dma_pending_;
+}
 
-    uint16_t source_address = value * 0x100; // multiply by 0x100 to retrieve the original source address
-    for (int i = 0; i < 160 ; i++) { // write to 160 possible OAM locations
-        oam_[i] = bus_->read(source_address + i);
+void PPU::copy_oam_dma_(int bytes)
+{
+    /* The DMG's sources 0xe0 - 0xff are the echo of work RAM. Every source that is memory is copied straight from it; a
+    page that is not (disabled cartridge RAM, the RTC registers) reads as one value throughout */
+    uint8_t page = dma_source_ >= 0xe0 ? dma_source_ - 0x20 : dma_source_;
+    const uint8_t* source = page >= 0x80 && page <= 0x9f ? &vram_[(page - 0x80) * 0x100] : bus_->dma_source(page);
+    if (source) {
+        std::copy(source, source + bytes, oam_.begin());
+    }
+    else {
+        std::fill_n(oam_.begin(), bytes, bus_->peek(page * 0x100));
     }
 }
 
@@ -403,11 +514,17 @@ void PPU::oam_scan()
 
    scanline_sprites_.clear(); // first, clear any objects from previous scanlines 
 
+    // while a DMA transfer is writing OAM the PPU cannot read it, and finds no objects
+    finish_oam_dma();
+    if (oam_dma_blocks(bus_->cycle_count())) {
+        return;
+    }
+
     // cycle through the OAM, only need to check the first byte of every object (4 bytes) to determine Y pos
     for (int byte0 = 0; byte0 < 160; byte0 += 4) {
-        uint8_t y_pos = oam_[byte0] - 16;
+        int y_pos = oam_[byte0] - 16; // objects above the screen are partially visible
         // check if the current scanline (ly) is within this object's top scanline and its bottom scanline
-        if (ly_ >= y_pos && ly_ <= y_pos + (8 * (1 + lcdc_.obj_size))) { // object is either 8 pixels tall or 16 pixels tall depending on LCDC bit
+        if (ly_ >= y_pos && ly_ < y_pos + (8 * (1 + lcdc_.obj_size))) { // object is either 8 pixels tall or 16 pixels tall depending on LCDC bit
             scanline_sprites_.push_back(byte0); // store the objects position in the OAM array
         }
         if (scanline_sprites_.size() == 10) {
@@ -415,218 +532,96 @@ void PPU::oam_scan()
         }
     }
 }
-void PPU::draw_bg_window()
+void PPU::draw_scanline()
 {
-    /*
-    This method is called by the draw_scanline method. It deals with drawing the background and window tiles. 
-    */
-
-    // ----- BACKGROUND AND WINDOW ----- 
-
-    // first, we need to check if the window is enabled, and if it is, then is the current scanline part of that window?
-    // NOTE: the window is a fixed rectangle on top of the background layer (i.e. a status bar)
-    bool window_enabled = false;
-
-    if (lcdc_.window_enable) {
-        if (wy_ <= ly_) { // only the top left coordinate of the window can be specified; this condition means that this scanline contains the window 
-            window_enabled = true;        
-        }
-    }
-
-    // which tile map we use depends on 1) whether we are accessing window or background tile maps, 2) lcdc bits
-    uint16_t tile_map_address;
-    if (window_enabled) {
-        // use window tile map
-        if (lcdc_.window_tile_map) {
-            tile_map_address = 0x9c00;
-        }
-        else {
-            tile_map_address = 0x9800;
-        }
-    }
-    else {
-        // use background tile map 
-        if (lcdc_.bg_tile_map) {
-            tile_map_address = 0x9c00;
-        }
-        else {
-            tile_map_address = 0x9800;
+    /*  Draw the scanline during mode 3 of the PPU. In a hardware accurate GameBoy emulator, this should draw one
+        pixel per cycle; this method will draw the whole scanline at once at the beginning of mode 3 */
+    screen_cleared_ = false;
+    lines_drawn_++;
+    LineState line = capture_line_();
+    if (renderer_ == Renderer::Deferred) {
+        // drawn at VBlank, with VRAM as it is now
+        FrameLog& log = logs_[log_];
+        if (log.lines.empty()) {
+            log.vram = vram_;
         }
+        log.lines.push_back(line);
+        return;
     }
+    draw_line(line, vram_.data(), &framebuffer_[ly_ * SCREEN_WIDTH]);
+}
 
-    // check where we read tiles from (the current addressing mode)
-    uint16_t tile_data_address;
-    bool signed_addressing = false; // indexing is always done using an 8 bit integer, however depending on the addressing mode this can be signed or unsigned
-    if (lcdc_.bg_window_tile_data) {
-        tile_data_address = 0x8000;
-    }
-    else {
-        tile_data_address = 0x9000; // 0x8800 method uses 0x9000 as base pointer, and uses signed addressing
-        signed_addressing = true;
+LineState PPU::capture_line_()
+{
+    /* Everything the scanline renderer reads for this line but VRAM */
+    LineState line;
+    line.ly = ly_;
+    line.scx = scx_;
+    line.scy = scy_;
+    line.wx = wx_;
+    line.wy = wy_;
+    line.lcdc = lcdc_.value_;
+    line.bgp = bgp_;
+    line.obp0 = obp0_;
+    line.obp1 = obp1_;
+    line.window_line = window_line_;
+    line.sprite_count = static_cast<uint8_t>(scanline_sprites_.size());
+    for (size_t sprite = 0; sprite < scanline_sprites_.size(); sprite++) {
+        std::copy_n(&oam_[scanline_sprites_[sprite]], 4, &line.sprites[sprite * 4]);
     }
-    
+    window_drawn_ = window_visible_on_line_();
+    return line;
+}
 
-    /*  The next step is to index into the VRAM tile maps. The background of the Game Boy is defined by 32 x 32 tiles. Each of these tiles has 8x8 pixels. Overall, this corresponds to a larger display than our actual display.
-        The next step is to figure out which pixels actually need to be drawn to screen */ 
-    
-    // first, figure out the Y coordinate relative to either the viewport, or the position of the window (if the window is enabled)
-    int y_coordinate;
-    if (window_enabled) {
-        // if the window is enabled, find the Y position relative to the top line of the window (i.e. "window coordinates")
-        // INVARIANT: y_coordinate >= 0 since window_enabled == true if wy_ <= ly_
-        y_coordinate = ly_ - wy_;
+void PPU::set_renderer(Renderer renderer)
+{
+    /* The lines of the frame logged so far are drawn right away, the next ones with the new renderer */
+    collect_frame_();
+    if (renderer_ == Renderer::Deferred && renderer != Renderer::Deferred && !logs_[log_].lines.empty()) {
+        rasterizer_->start(&logs_[log_], framebuffer_.data());
+        rasterizer_->finish();
+        logs_[log_].clear();
     }
-    else {
-        // the window is not enabled, so find Y position in "background coordinates". We know that the background begins drawing from where the viewport top left corner is defined
-        y_coordinate = (scy_ + ly_) % 256;
+    if (renderer == Renderer::Deferred && !rasterizer_) {
+        rasterizer_ = std::make_unique<Rasterizer>(raster_threads_);
     }
+    renderer_ = renderer;
+}
 
-    // Now, we need to find which row of the tile map this y coordinate can be found. First, finding the integer division by 8 finds which row this pixel belongs to (e.g. pixel 6 belongs to row 0, pixel 35 belongs to row 1, etc.). 
-    // and then multiplying by 32 gives the index into the row in memory
-
-    uint16_t tile_map_y_index = static_cast<uint8_t>(y_coordinate / 8) * 32;
-
-    // draw each pixel along the scanline
-    int x_coordinate;
-    for (int pixel = 0; pixel < SCREEN_WIDTH; pixel++) {
-        // again, finding the x coordinate depends on whether or not the window is enabled or not: find the coordinate relative to the window or the viewport
-        if (window_enabled) {
-            // adjust the x coordinate into window space if it is within the window
-            if (pixel >= wx_ - 7) {
-                x_coordinate = pixel - (wx_ - 7);
-            }
-        }
-        else {
-            // x coordinate relative to the viewport
-            x_coordinate = (scx_ + pixel) % 256;
-        }
-
-
-        // similar to finding the Y index, we need to find the x index to find a final uint8_t index into the tilemap
-        uint8_t tile_map_x_index = static_cast<uint8_t>(x_coordinate / 8); // divide by 8 to bucket into one of 32 8x8 tiles in the row
-
-        uint16_t tile_index = tile_map_address + (tile_map_y_index + tile_map_x_index); // find the location of the 1 byte index of the tile in the tile data in VRAM
-
-        uint16_t tile_data_location;
-        if (!signed_addressing) {
-            // if using unsigned addressing, the base pointer is at 0x8000, and use unsigned 8 bit index to index into block 0 or block 1 
-            // Each tile is 16 bytes in size. Given the tile index, we can find the location of the first byte of the tile by multiplying the index by 16 
-            tile_data_location = tile_data_address + vram_[tile_index - 0x8000] * 16; 
-        }
-        else {
-            // using the 0x8800 method, uses 0x9000 as base pointer
-            tile_data_location = tile_data_address + static_cast<int8_t>(vram_[tile_index - 0x8000]) * 16;
-        }
-
-        // Now, we have the base pointer for the 16 bytes of tile data. Currently, we are on a specific scanline, and therefore are dealing with a specific 
-        // y coordinate. Therefore, we need to find that specific row of tile data that we are currently dealing with
-
-        uint8_t tile_row = y_coordinate % 8; // given the y coordinate, which row of colour data in the an 8x8 tile is this?
-        tile_row *= 2; // adjust for the fact that every line of tile data contains 2 bytes (every colour row is 2 * 8 bytes of data, so the first row of colour data is row 0, 1, the second row of colour data is row 2,3, etc.) 
-
-        // read the two bytes corresponding to this row of the tile
-        // first byte specifies the least significant bit of the color ID, second byte specifies the most significant bit (for the specific x, y pixel we are currently observing)
-        uint8_t byte1 = vram_[(tile_data_location + tile_row + 0) - 0x8000];
-        uint8_t byte2 = vram_[(tile_data_location + tile_row + 1) - 0x8000];
-
-        // The final step is to get the colour - first, get the ID from the two bytes - bit 7 represents the leftmost pixel, bit 0 represents the rightmost
-        uint8_t bit_number = ((x_coordinate % 8) - 7) * (-1); // which column in the tile data is the x coordinate, and then accounting for bit 7 being the leftmost pixel
-        uint8_t msb = ((byte2 & (1 << bit_number)) >> bit_number) << 1;
-        uint8_t lsb = (byte1 & (1 << bit_number)) >> bit_number; 
-
-        uint8_t colour_ID = msb + lsb;
-
-        // match the colour ID to its actual colour using the palette 
-        int r; int g; int b;
-        set_colour_from_palette(&r, &g, &b, colour_ID, bgp_);
-        frame_background_colour.at(ly_ * SCREEN_WIDTH + pixel) = r; // one channel is enough to tell us the colour
-        SDL_SetRenderDrawColor(renderer_, r, g, b, SDL_ALPHA_OPAQUE);
-        SDL_RenderDrawPoint(renderer_, pixel, ly_);
+void PPU::set_raster_threads(int threads)
+{
+    collect_frame_();
+    raster_threads_ = threads;
+    if (rasterizer_) {
+        rasterizer_ = std::make_unique<Rasterizer>(raster_threads_);
     }
 }
 
-void PPU::draw_sprites()
+void PPU::collect_frame_()
 {
-    /*
-    This method is called by the draw_scanline method. It deals with drawing the sprites. 
-    */
-
-    // TODO: background priority
-    // for (int i = scanline_sprites_.size() - 1; i >= 0; i--) { // go backwards since objects that occur in OAM first have higher priority
-    for (int sprite_loc : scanline_sprites_) {
-        // int sprite_loc = scanline_sprites_[i];
-        uint8_t y_pos = oam_[sprite_loc + 0] - 16; 
-        uint8_t x_pos = oam_[sprite_loc + 1] - 8; 
-        uint8_t tile_index = oam_[sprite_loc + 2];
-        uint8_t attributes = oam_[sprite_loc + 3];
-
-        uint8_t x_flip = (attributes & 0b100000) >> 5;
-        uint8_t y_flip = (attributes & 0b1000000) >> 6;
-        uint8_t priority = (attributes & 0b10000000) >> 7;
-        uint8_t palette = (attributes & 0b10000) >> 4;
-        
-        // since we already checked in the OAM scan, we know that this sprite intersects with this
-        // scanline. However, we need to find which line of the 8x8 or 8x16 sprite we are rendering
-
-        int8_t sprite_line = (ly_ - y_pos); 
-
-        if (y_flip) {
-            sprite_line -= (8 + (1 * lcdc_.obj_size));
-            sprite_line *= -1;
-        }
-        sprite_line *= 2; // a lot of this logic follows the bg and window rendering: each tile has 2 bytes of information per row
-
-        uint16_t tile_address = (tile_index * 16) + sprite_line; // only unsigned addressing for sprites
-        // read the two bytes corresponding to this row of the tile
-        // first byte specifies the least significant bit of the color ID, second byte specifies the most significant bit (for the specific x, y pixel we are currently observing)
-        uint8_t byte1 = vram_[tile_address + 0];
-        uint8_t byte2 = vram_[tile_address + 1];
-
-        // draw 8 pixels across
-        for (int bit_number = 7; bit_number >= 0; bit_number--) {
-            int colour_bit = bit_number;
-            if (x_flip) {
-                colour_bit = (bit_number - 7) * -1;
-            }
-
-            uint8_t msb = ((byte2 & (1 << colour_bit)) >> colour_bit) << 1;
-            uint8_t lsb = (byte1 & (1 << colour_bit)) >> colour_bit; 
-            uint8_t colour_ID = msb + lsb;
-
-            // in sprite palettes, ignore the lower 2 bits (transparent)
-            if (colour_ID != 0) {
-                // match the colour ID to its actual colour using the palette 
-                int r; int g; int b;
-                if (palette) {
-                    set_colour_from_palette(&r, &g, &b, colour_ID, obp1_);
-                }
-                else {
-                    set_colour_from_palette(&r, &g, &b, colour_ID, obp0_);
-                }
-
-                SDL_SetRenderDrawColor(renderer_, r, g, b, SDL_ALPHA_OPAQUE);
-
-                uint8_t x_pixel = x_pos + (7 - bit_number); // 7th bit is leftmost pixel
-
-                if ((x_pixel >= 0 && x_pixel <= SCREEN_WIDTH) && (ly_ >= 0 && ly_ <= SCREEN_HEIGHT)) {
-                    if (priority && frame_background_colour.at(ly_ * SCREEN_WIDTH + x_pixel) != 242) {
-                        continue;
-                    }
-                    SDL_RenderDrawPoint(renderer_, x_pixel, ly_);
-                }
-            }
-        }
+    /* Wait for the frame the rasterizer is drawing, and complete it */
+    if (!rasterizing_) {
+        return;
+    }
+    if (perf_counters_) {
+        perf_counters_->begin(PerfCounters::Render);
+        rasterizer_->finish();
+        perf_counters_->end(PerfCounters::Render);
     }
+    else {
+        rasterizer_->finish();
+    }
+    rasterizing_ = false;
+    completed_frame_ = framebuffer_;
+    frame_hash_ = hash::xxh64(completed_frame_.data(), completed_frame_.size());
+    completed_number_ = rasterizing_number_;
 }
 
-void PPU::draw_scanline()
+void PPU::poll_frame()
 {
-    /*  Draw the scanline during mode 3 of the PPU. In a hardware accurate GameBoy emulator, this should draw one
-        pixel per cycle; this method will draw the whole scanline at once at the beginning of mode 3 */
-    screen_cleared_ = false;
-
-    draw_bg_window();
-    draw_sprites(); 
+    if (rasterizing_ && rasterizer_->drawn()) {
+        collect_frame_();
+    }
 }
 
 
@@ -642,36 +637,24 @@ void PPU::stat::set(uint8_t new_lcdc)
     mode0_select = new_lcdc & (1 << 3);
 }
 
-bool PPU::stat::set_lyc_equals(uint8_t ly, uint8_t lyc) 
+void PPU::stat::set_lyc_equals(uint8_t ly, uint8_t lyc) 
 {
     if (ly == lyc) {
         lyc_equals = 1;
         value_ |= (1 << 2); // set the LYC == LC bit
-        if (lyc_select) { // check the condition for the STAT interrupt
-            return true;        
-        } 
     }
     else {
         lyc_equals = 0; 
         value_ &= 0b01111011; // clear the LYC == LC bit
     }
-    
-    return false;
 }
 
 
-bool PPU::stat::set_mode(uint8_t mode) 
+void PPU::stat::set_mode(uint8_t mode) 
 {
     ppu_mode_ = mode;
     value_ &= 0b01111100; // clear previous mode bits
     value_ |= mode;       // set mode bits
-
-    if ((mode != 3) && (value_ & (1 << (mode + 3)))) { // every mode has a select apart from mode 3
-    // trigger a STAT interrupt
-        return true;
-    }
-
-    return false;
 }
 
 // -- LCDC REGISTER methods --
@@ -0,0 +1,186 @@
+#include <algorithm>
+#include <cstdint>
+
+#include "ppu.h"
+#include "perf_counters.h"
+
+/*
+The pixel FIFO engine: mode 3 is run one dot at a time, the way the hardware draws a line (Pan Docs "Pixel FIFO").
+
+A fetcher reads the background (or window) tiles 8 pixels at a time: 2 dots for the tile number, 2 for each byte of the
+tile's row, then it pushes the 8 colour IDs to the background FIFO as soon as that is empty. Every dot one pixel is
+popped from the FIFO and mixed with the object FIFO onto the screen. The first SCX % 8 pixels of the line are thrown
+away, the window restarts the fetcher on its own tiles once the pixel reaches WX - 7, and an object at the next pixel
+stalls everything for as long as its fetch and the wait for the background fetch take (object_stall_). Registers are
+read when the fetcher or the mixing needs them, so writes during mode 3 change the rest of the line, and mode 3 lasts
+until the last pixel is out instead of drawing_length_().
+*/
+
+void PPU::fifo_start_line_()
+{
+    /* Mode 3 starts: the fetcher starts on the first background tile, and the objects found by oam_scan are fetched from
+    left to right (objects at the same X in OAM order) */
+    fifo_ = PixelFifo();
+    fifo_.drawing = true;
+    fifo_.discard = scx_ % 8;
+    for (int sprite : scanline_sprites_) {
+        fifo_.sprites[fifo_.sprite_count++] = static_cast<uint8_t>(sprite);
+    }
+    std::stable_sort(fifo_.sprites.begin(), fifo_.sprites.begin() + fifo_.sprite_count, [&](uint8_t a, uint8_t b) { return oam_[a + 1] < oam_[b + 1]; });
+    screen_cleared_ = false;
+}
+
+void PPU::fifo_render_dot_()
+{
+    /* One dot of mode 3, the drawing_'th of the line. Reading the perf counters costs more than a dot, so only every
+    render_sample_stride'th is counted under Render, and scaled up (as the CPU's cycles are) */
+    if (perf_counters_ && drawing_ % render_sample_stride == 0) {
+        perf_counters_->begin(PerfCounters::Render);
+        fifo_dot_();
+        perf_counters_->end(PerfCounters::Render, render_sample_stride);
+    }
+    else {
+        fifo_dot_();
+    }
+}
+
+void PPU::fifo_dot_()
+{
+    if (fifo_.delay > 0) {
+        fifo_.delay--;
+        return;
+    }
+
+    if (fifo_.stall > 0) {
+        fifo_.stall--;
+        return;
+    }
+
+    fifo_fetch_();
+    if (fifo_.background_count == 0) {
+        return;
+    }
+    if (fifo_.discard > 0) {
+        fifo_.background_count--;
+        fifo_.discard--;
+        return;
+    }
+
+    // the window starts: the pixels fetched from the background are dropped, and the fetcher starts over on the window
+    if (!fifo_.window && window_visible_on_line_() && fifo_.x + 7 >= wx_) {
+        fifo_.window = true;
+        window_drawn_ = true;
+        fifo_.step = 0;
+        fifo_.tile_x = 0;
+        fifo_.background_count = 0;
+        fifo_fetch_();
+        return;
+    }
+
+    // an object starting at this pixel (or left of the screen) stalls the FIFO while it is fetched
+    if (lcdc_.obj_enable && fifo_.next_sprite < fifo_.sprite_count && oam_[fifo_.sprites[fifo_.next_sprite] + 1] <= fifo_.x + 8) {
+        fifo_fetch_sprite_();
+        return;
+    }
+
+    fifo_output_();
+}
+
+void PPU::fifo_fetch_()
+{
+    switch (fifo_.step) {
+        case 0: {
+            // the tile number, from the window's tile map or the background's, scrolled by SCX / SCY as they are now
+            uint16_t map;
+            if (fifo_.window) {
+                map = (lcdc_.window_tile_map ? 0x1c00 : 0x1800) + window_line_ / 8 * 32 + (fifo_.tile_x & 31);
+            }
+            else {
+                uint8_t y = scy_ + ly_;
+                map = (lcdc_.bg_tile_map ? 0x1c00 : 0x1800) + y / 8 * 32 + ((scx_ / 8 + fifo_.tile_x) & 31);
+            }
+            fifo_.tile = vram_[map];
+            break;
+        }
+        case 2:
+        case 4: {
+            uint8_t row = fifo_.window ? window_line_ % 8 : static_cast<uint8_t>(scy_ + ly_) % 8;
+            uint16_t address = lcdc_.bg_window_tile_data ? fifo_.tile * 16 : 0x1000 + static_cast<int8_t>(fifo_.tile) * 16;
+            address += row * 2;
+            if (fifo_.step == 2) {
+                fifo_.low = vram_[address];
+            }
+            else {
+                fifo_.high = vram_[address + 1];
+            }
+            break;
+        }
+        case 6:
+            // push, once the FIFO is empty
+            if (fifo_.background_count > 0) {
+                return;
+            }
+            for (int pixel = 0; pixel < 8; pixel++) {
+                int bit = 7 - pixel;
+                fifo_.background[pixel] = ((fifo_.low >> bit) & 1) | (((fifo_.high >> bit) & 1) << 1);
+            }
+            fifo_.background_count = 8;
+            fifo_.tile_x++;
+            fifo_.step = 0;
+            return;
+    }
+    fifo_.step++;
+}
+
+void PPU::fifo_fetch_sprite_()
+{
+    /* Merge the next object's row into the object FIFO: its pixels only go where no object pixel is yet (objects fetched
+    earlier, more to the left or earlier in OAM, win) */
+    uint8_t sprite = fifo_.sprites[fifo_.next_sprite++];
+    int x = oam_[sprite + 1] - 8;
+    fifo_.stall = object_stall_(oam_[sprite + 1], fifo_.window && x >= wx_ - 7, fifo_.waited) - 1; // this dot is the first
+    uint8_t attributes = oam_[sprite + 3];
+    int height = lcdc_.obj_size ? 16 : 8;
+    int line = ly_ - (oam_[sprite] - 16);
+    if (attributes & 0x40) {
+        line = height - 1 - line;
+    }
+    uint8_t tile = lcdc_.obj_size ? oam_[sprite + 2] & 0xfe : oam_[sprite + 2];
+    uint16_t address = tile * 16 + line * 2;
+    uint8_t low = vram_[address];
+    uint8_t high = vram_[address + 1];
+
+    for (int pixel = 0; pixel < 8; pixel++) {
+        int offset = x + pixel - fifo_.x; // from the next pixel
+        if (offset < 0 || offset >= 8) {
+            continue; // left of the screen
+        }
+        int bit = attributes & 0x20 ? pixel : 7 - pixel;
+        ObjectPixel& slot = fifo_.objects[(fifo_.object_head + offset) % 8];
+        uint8_t colour = ((low >> bit) & 1) | (((high >> bit) & 1) << 1);
+        if (slot.colour == 0 && colour != 0) {
+            slot.colour = colour;
+            slot.palette = (attributes & 0x10) != 0;
+            slot.behind = (attributes & 0x80) != 0;
+        }
+    }
+}
+
+void PPU::fifo_output_()
+{
+    /* Mix the next background and object pixels with the palettes as they are now. With LCDC bit 0 clear the background
+    and the window are white, and every object is drawn over them */
+    uint8_t background = lcdc_.enable_priority ? fifo_.background[8 - fifo_.background_count] : 0;
+    fifo_.background_count--;
+    ObjectPixel object = fifo_.objects[fifo_.object_head];
+    fifo_.objects[fifo_.object_head] = ObjectPixel();
+    fifo_.object_head = (fifo_.object_head + 1) % 8;
+
+    uint8_t shade = lcdc_.enable_priority ? get_shade_from_palette(background, bgp_) : 0;
+    if (object.colour != 0 && lcdc_.obj_enable && !(object.behind && background != 0)) {
+        shade = get_shade_from_palette(object.colour, object.palette ? obp1_ : obp0_);
+    }
+    framebuffer_[ly_ * SCREEN_WIDTH + fifo_.x] = shade;
+    fifo_.x++;
+    fifo_.drawing = fifo_.x < SCREEN_WIDTH;
+}
\ No newline at end of file
@@ -0,0 +1,226 @@
+#include "profiler.h"
+#include "cartridge.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+// max depth of the shadow call stack. Code that calls without ever returning (e.g. jumping back to the main loop from
+// a handler) would otherwise grow it forever, so the oldest frames are dropped
+static constexpr size_t max_stack_depth = 256;
+
+const std::array<Profiler::BranchKind, 256> Profiler::branch_kind_ = [] {
+    std::array<BranchKind, 256> kinds;
+    kinds.fill(None);
+    // CALL, CALL cc
+    for (uint8_t opcode : {0xcd, 0xc4, 0xcc, 0xd4, 0xdc}) {
+        kinds[opcode] = Call;
+    }
+    // RST n
+    for (uint8_t opcode : {0xc7, 0xcf, 0xd7, 0xdf, 0xe7, 0xef, 0xf7, 0xff}) {
+        kinds[opcode] = Call;
+    }
+    // RET, RET cc, RETI
+    for (uint8_t opcode : {0xc9, 0xc0, 0xc8, 0xd0, 0xd8, 0xd9}) {
+        kinds[opcode] = Return;
+    }
+    return kinds;
+}();
+
+Profiler::Profiler(Cartridge* cartridge, bool exact, uint32_t sample_period) :
+    cartridge_(cartridge), exact_(exact), sample_period_(std::max(1u, sample_period)), unbanked_cycles_(0x10000, 0)
+{
+    nodes_.push_back({0, 0});
+}
+
+void Profiler::load_symbols(std::string sym_file)
+{
+    /* Read the "BB:AAAA Name" lines of an RGBDS symbol file. Local labels (Function.loop) are kept to name instructions,
+    the function totals of the report strip them again */
+    std::ifstream sym_reader(sym_file);
+
+    if (!sym_reader) {
+        throw std::runtime_error("could not open the symbol file " + sym_file + ".");
+    }
+
+    std::string line;
+    while (std::getline(sym_reader, line)) {
+        line = line.substr(0, line.find(';'));
+        unsigned int bank, address;
+        char name[256];
+        if (sscanf(line.c_str(), "%x:%x %255s", &bank, &address, name) == 3) {
+            symbols_[(bank << 16) | address] = name;
+        }
+    }
+}
+
+uint32_t Profiler::location_(uint16_t address)
+{
+    if (address >= 0x4000 && address <= 0x7fff) {
+        return (static_cast<uint32_t>(cartridge_->rom_bank()) << 16) | address;
+    }
+    return address;
+}
+
+void Profiler::enter_(uint32_t function, uint16_t sp)
+{
+    /* push a frame for a call to function, creating its node in the call tree on the first call from this path */
+    uint32_t parent = stack_.empty() ? 0 : stack_.back().node;
+    uint64_t key = (static_cast<uint64_t>(parent) << 32) | function;
+    auto child = children_.find(key);
+    if (child == children_.end()) {
+        child = children_.emplace(key, nodes_.size()).first;
+        nodes_.push_back({function, parent});
+    }
+
+    if (stack_.size() == max_stack_depth) {
+        stack_.erase(stack_.begin());
+    }
+    stack_.push_back({child->second, sp});
+}
+
+void Profiler::resolve_branch_(uint16_t pc, uint16_t sp)
+{
+    /* a taken call pushed a return address (SP went down by 2), a taken return popped one */
+    if (pending_ == Call && static_cast<uint16_t>(pending_sp_ - 2) == sp) {
+        enter_(location_(pc), sp);
+    }
+    else if (pending_ == Return && static_cast<uint16_t>(pending_sp_ + 2) == sp) {
+        // drop every frame whose return address is now off the stack (the code may have popped some itself)
+        while (!stack_.empty() && stack_.back().sp < sp) {
+            stack_.pop_back();
+        }
+    }
+    pending_ = None;
+}
+
+void Profiler::interrupt(uint16_t return_pc, uint16_t handler, uint16_t sp)
+{
+    // the interrupted instruction has completed (and may have been a call to return_pc), so settle it first
+    if (pending_ != None) {
+        resolve_branch_(return_pc, static_cast<uint16_t>(sp + 2));
+    }
+    enter_(handler, sp);
+}
+
+void Profiler::sample_(uint64_t cycle)
+{
+    /* charge the cycles since the last sample to the instruction that was executing (and its call path) */
+    uint32_t location = location_(previous_pc_);
+    uint64_t cycles = cycle - last_cycle_;
+    if (location < 0x10000) {
+        unbanked_cycles_[location] += cycles;
+    }
+    else {
+        size_t bank = location >> 16;
+        if (bank >= banked_cycles_.size()) {
+            banked_cycles_.resize(bank + 1);
+        }
+        if (!banked_cycles_[bank]) {
+            banked_cycles_[bank] = std::make_unique<std::array<uint64_t, 0x4000>>();
+            banked_cycles_[bank]->fill(0);
+        }
+        (*banked_cycles_[bank])[location & 0x3fff] += cycles;
+    }
+    nodes_[stack_.empty() ? 0 : stack_.back().node].cycles += cycles;
+    total_cycles_ += cycles;
+    last_cycle_ = cycle;
+
+    if (!exact_) {
+        // jitter the period by +-50%, so periodic code (the frame loop) cannot line up with the samples
+        random_ ^= random_ << 13;
+        random_ ^= random_ >> 7;
+        random_ ^= random_ << 17;
+        next_sample_ = cycle + sample_period_ / 2 + random_ % sample_period_;
+    }
+}
+
+std::string Profiler::name_(uint32_t location, bool offset)
+{
+    /* name a location after the closest symbol at or before it in the same memory region */
+    auto region = [](uint32_t location) {
+        uint16_t address = location & 0xffff;
+        return address < 0x4000 ? 0 : address < 0x8000 ? 1 : (address >> 13);
+    };
+
+    auto symbol = symbols_.upper_bound(location);
+    if (symbol != symbols_.begin()) {
+        symbol--;
+        if ((symbol->first >> 16) == (location >> 16) && region(symbol->first) == region(location)) {
+            std::string name = symbol->second;
+            if (offset && symbol->first != location) {
+                std::stringstream stream;
+                stream << "+0x" << std::hex << (location - symbol->first);
+                name += stream.str();
+            }
+            return name;
+        }
+    }
+
+    std::stringstream stream;
+    stream << std::hex << std::setfill('0') << std::setw(2) << (location >> 16) << ":" << std::setw(4) << (location & 0xffff);
+    return stream.str();
+}
+
+void Profiler::write_report(std::ostream& out, size_t top)
+{
+    /* top functions (every location grouped under its closest symbol), then top instructions */
+    std::vector<std::pair<uint64_t, uint32_t>> locations;
+    for (uint32_t address = 0; address < 0x10000; address++) {
+        if (unbanked_cycles_[address] > 0) {
+            locations.push_back({unbanked_cycles_[address], address});
+        }
+    }
+    for (uint32_t bank = 0; bank < banked_cycles_.size(); bank++) {
+        if (banked_cycles_[bank]) {
+            for (uint32_t offset = 0; offset < 0x4000; offset++) {
+                if ((*banked_cycles_[bank])[offset] > 0) {
+                    locations.push_back({(*banked_cycles_[bank])[offset], (bank << 16) | (0x4000 + offset)});
+                }
+            }
+        }
+    }
+
+    std::unordered_map<std::string, uint64_t> function_cycles;
+    for (const auto& [cycles, location] : locations) {
+        std::string name = name_(location, false);
+        function_cycles[name.substr(0, name.find('.'))] += cycles;
+    }
+    std::vector<std::pair<uint64_t, std::string>> functions;
+    for (const auto& [name, cycles] : function_cycles) {
+        functions.push_back({cycles, name});
+    }
+
+    auto print = [&](auto& rows, const std::string& title, auto name) {
+        std::sort(rows.begin(), rows.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+        out << title << "\n";
+        for (size_t i = 0; i < std::min(top, rows.size()); i++) {
+            double percent = total_cycles_ ? 100.0 * rows[i].first / total_cycles_ : 0;
+            out << std::setw(14) << rows[i].first << std::fixed << std::setprecision(2) << std::setw(8) << percent << "%  " << name(rows[i].second) << "\n";
+        }
+        out << "\n";
+    };
+
+    out << "Total: " << total_cycles_ << " cycles" << (exact_ ? "" : " (sampled)") << "\n\n";
+    print(functions, "Functions (self cycles):", [](const std::string& name) { return name; });
+    print(locations, "Instructions:", [&](uint32_t location) { return name_(location, true); });
+}
+
+void Profiler::write_folded(std::ostream& out)
+{
+    /* one line per call path with self cycles: root frame first, separated by semicolons */
+    std::vector<std::string> paths(nodes_.size());
+    paths[0] = "[root]";
+    for (uint32_t node = 1; node < nodes_.size(); node++) {
+        // parents are always created before their children
+        paths[node] = paths[nodes_[node].parent] + ";" + name_(nodes_[node].function, true);
+    }
+
+    for (uint32_t node = 0; node < nodes_.size(); node++) {
+        if (nodes_[node].cycles > 0) {
+            out << paths[node] << " " << nodes_[node].cycles << "\n";
+        }
+    }
+}
\ No newline at end of file
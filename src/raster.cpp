@@ -0,0 +1,219 @@
+#include "raster.h"
+#include <algorithm>
+
+static uint8_t get_shade_from_palette(uint8_t colour_ID, uint8_t palette)
+{
+    /* Given a colour ID, find the shade (0 = near-white, 1 = light gray, 2 = dark gray, 3 = black) using the palette */
+    return (palette >> (colour_ID * 2)) & 0b11;
+}
+
+static void draw_bg_window(const LineState& line, const uint8_t* vram, uint8_t* row, uint8_t* background)
+{
+    /* Draw the background, and the window over it from WX - 7 on if it is on this line. The shades are also kept in
+    background, for the objects' priority */
+
+    // the window is a fixed rectangle on top of the background layer (i.e. a status bar), starting at line WY. LCDC.0
+    // blanks it on the DMG (see PPU::window_visible_on_line_)
+    bool window_enabled = (line.lcdc & 0x21) == 0x21 && line.wy <= line.ly;
+
+    // which tile map each uses depends on the lcdc bits
+    uint16_t window_map = line.lcdc & 0x40 ? 0x1c00 : 0x1800;
+    uint16_t background_map = line.lcdc & 0x08 ? 0x1c00 : 0x1800;
+
+    // with the 0x8800 method, indices are signed and 0x9000 is the base pointer
+    bool signed_addressing = !(line.lcdc & 0x10);
+
+    // the y coordinate relative to the top of the window (in its own lines), or in the 256x256 background
+    uint8_t window_y = line.window_line;
+    uint8_t background_y = line.scy + line.ly;
+
+    for (int pixel = 0; pixel < SCREEN_WIDTH; pixel++) {
+        uint16_t tile_map;
+        uint8_t x_coordinate;
+        uint8_t y_coordinate;
+        if (window_enabled && pixel >= line.wx - 7) {
+            tile_map = window_map;
+            x_coordinate = pixel - (line.wx - 7);
+            y_coordinate = window_y;
+        }
+        else {
+            tile_map = background_map;
+            x_coordinate = line.scx + pixel;
+            y_coordinate = background_y;
+        }
+
+        // the background is 32 x 32 tiles of 8x8 pixels: find the tile's index in the map
+        uint8_t tile_index = vram[tile_map + (y_coordinate / 8) * 32 + x_coordinate / 8];
+
+        // each tile is 16 bytes, 2 per row
+        uint16_t tile_data_location;
+        if (!signed_addressing) {
+            tile_data_location = tile_index * 16;
+        }
+        else {
+            tile_data_location = 0x1000 + static_cast<int8_t>(tile_index) * 16;
+        }
+        uint8_t tile_row = (y_coordinate % 8) * 2;
+
+        // first byte specifies the least significant bit of the color ID, second byte specifies the most significant bit
+        uint8_t byte1 = vram[tile_data_location + tile_row + 0];
+        uint8_t byte2 = vram[tile_data_location + tile_row + 1];
+
+        // bit 7 is the leftmost pixel
+        uint8_t bit_number = 7 - x_coordinate % 8;
+        uint8_t colour_ID = (((byte2 >> bit_number) & 1) << 1) | ((byte1 >> bit_number) & 1);
+
+        uint8_t shade = get_shade_from_palette(colour_ID, line.bgp);
+        background[pixel] = shade;
+        row[pixel] = shade;
+    }
+}
+
+static void draw_sprites(const LineState& line, const uint8_t* vram, uint8_t* row, const uint8_t* background)
+{
+    /* Draw the line's objects over the background, in OAM order */
+    uint8_t obj_size = (line.lcdc & 0x04) >> 2;
+    for (int sprite = 0; sprite < line.sprite_count; sprite++) {
+        const uint8_t* entry = &line.sprites[sprite * 4];
+        uint8_t y_pos = entry[0] - 16;
+        uint8_t x_pos = entry[1] - 8;
+        uint8_t tile_index = entry[2];
+        uint8_t attributes = entry[3];
+
+        uint8_t x_flip = (attributes & 0b100000) >> 5;
+        uint8_t y_flip = (attributes & 0b1000000) >> 6;
+        uint8_t priority = (attributes & 0b10000000) >> 7;
+        uint8_t palette = (attributes & 0b10000) >> 4;
+
+        // the OAM scan found that the object is on this line: find which line of the 8x8 or 8x16 object it is
+        int8_t sprite_line = (line.ly - y_pos);
+        if (y_flip) {
+            sprite_line = 8 * (1 + obj_size) - 1 - sprite_line;
+        }
+        if (obj_size) {
+            tile_index &= 0xfe; // 8x16 objects start on an even tile
+        }
+
+        uint16_t tile_address = (tile_index * 16) + sprite_line * 2; // only unsigned addressing for objects
+        uint8_t byte1 = vram[tile_address + 0];
+        uint8_t byte2 = vram[tile_address + 1];
+
+        // draw 8 pixels across
+        for (int bit_number = 7; bit_number >= 0; bit_number--) {
+            int colour_bit = x_flip ? 7 - bit_number : bit_number;
+            uint8_t colour_ID = (((byte2 >> colour_bit) & 1) << 1) | ((byte1 >> colour_bit) & 1);
+
+            // colour 0 is transparent in object palettes
+            if (colour_ID != 0) {
+                uint8_t shade = get_shade_from_palette(colour_ID, palette ? line.obp1 : line.obp0);
+                uint8_t x_pixel = x_pos + (7 - bit_number); // 7th bit is leftmost pixel
+                if (x_pixel < SCREEN_WIDTH) {
+                    if (priority && background[x_pixel] != 0) {
+                        continue;
+                    }
+                    row[x_pixel] = shade;
+                }
+            }
+        }
+    }
+}
+
+void draw_line(const LineState& line, const uint8_t* vram, uint8_t* row)
+{
+    std::array<uint8_t, SCREEN_WIDTH> background;
+    draw_bg_window(line, vram, row, background.data());
+    draw_sprites(line, vram, row, background.data());
+}
+
+Rasterizer::Rasterizer(int threads)
+{
+    bands_ = std::max(threads, 1);
+    for (int band = 0; band < threads; band++) {
+        workers_.emplace_back(&Rasterizer::worker_, this, band);
+    }
+}
+
+Rasterizer::~Rasterizer()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    start_.notify_all();
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+void Rasterizer::start(const FrameLog* log, uint8_t* framebuffer)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        log_ = log;
+        framebuffer_ = framebuffer;
+        running_ = static_cast<int>(workers_.size());
+        generation_++;
+    }
+    start_.notify_all();
+}
+
+void Rasterizer::finish()
+{
+    if (!log_) {
+        return;
+    }
+    if (workers_.empty()) {
+        draw_band_(0);
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this]() { return running_ == 0; });
+    log_ = nullptr;
+}
+
+bool Rasterizer::drawn()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return running_ == 0;
+}
+
+void Rasterizer::worker_(int band)
+{
+    uint64_t generation = 0;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        start_.wait(lock, [&]() { return stop_ || generation_ != generation; });
+        if (stop_) {
+            return;
+        }
+        generation = generation_;
+        lock.unlock();
+        draw_band_(band);
+        lock.lock();
+        if (--running_ == 0) {
+            done_.notify_one();
+        }
+    }
+}
+
+void Rasterizer::draw_band_(int band)
+{
+    /* Draw the lines [first, last) of the log, from VRAM as it was when the first line was logged with the journal
+    replayed up to each line */
+    size_t count = log_->lines.size();
+    size_t first = count * band / bands_;
+    size_t last = count * (band + 1) / bands_;
+    if (first == last) {
+        return;
+    }
+
+    std::array<uint8_t, 0x2000> vram = log_->vram;
+    const std::vector<FrameLog::VramWrite>& journal = log_->journal;
+    size_t write = 0;
+    for (size_t index = first; index < last; index++) {
+        for (; write < journal.size() && journal[write].line <= index; write++) {
+            vram[journal[write].address] = journal[write].value;
+        }
+        const LineState& line = log_->lines[index];
+        draw_line(line, vram.data(), framebuffer_ + line.ly * SCREEN_WIDTH);
+    }
+}
@@ -0,0 +1,94 @@
+#include "save_ram.h"
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+SaveRAM::SaveRAM(size_t size, const std::string& save_file, size_t footer_size)
+{
+    size_ = size;
+    if (!save_file.empty() && size + footer_size > 0) {
+        size_t length = size + footer_size;
+        fd_ = open(save_file.c_str(), O_RDWR | O_CREAT, 0644);
+        struct stat status;
+        if (fd_ >= 0 && fstat(fd_, &status) == 0) {
+            // extend the file, never shorten it
+            if (static_cast<size_t>(status.st_size) < length && ftruncate(fd_, length) != 0) {
+                close(fd_);
+                fd_ = -1;
+            }
+        }
+        if (fd_ >= 0) {
+            void* mapping = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+            if (mapping == MAP_FAILED) {
+                close(fd_);
+                fd_ = -1;
+            }
+            else {
+                data_ = static_cast<uint8_t*>(mapping);
+                mapped_ = length;
+            }
+        }
+        if (fd_ < 0) {
+            std::cout << "Warning: could not map the save file " << save_file << ", the game will not be saved." << std::endl;
+        }
+    }
+
+    if (fd_ < 0) {
+        memory_.resize(size + footer_size, 0);
+        data_ = memory_.data();
+        return;
+    }
+    thread_ = std::thread(&SaveRAM::writer_, this);
+}
+
+SaveRAM::~SaveRAM()
+{
+    if (fd_ < 0) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+
+    // the last changes are written by the thread before it stops
+    munmap(data_, mapped_);
+    close(fd_);
+}
+
+void SaveRAM::flush()
+{
+    if (fd_ < 0 || !dirty_.load(std::memory_order_relaxed)) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        flush_requested_ = true;
+    }
+    wake_.notify_one();
+}
+
+void SaveRAM::writer_()
+{
+    /* Sync when asked to, and every flush_interval otherwise; a last time when stopping */
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stop_) {
+        wake_.wait_for(lock, flush_interval, [this]() { return flush_requested_ || stop_; });
+        flush_requested_ = false;
+        lock.unlock();
+        sync_();
+        lock.lock();
+    }
+}
+
+void SaveRAM::sync_()
+{
+    // the flag is cleared first: a write during the msync marks the RAM dirty again, and is synced next time
+    if (dirty_.exchange(false, std::memory_order_relaxed)) {
+        msync(data_, mapped_, MS_SYNC);
+    }
+}
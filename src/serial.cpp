@@ -14,7 +14,10 @@ void Serial::write_sc(uint8_t value)
     
     if (value == 0x81) {
         char letter = read_sb();    
-        std::cout << letter;
+        output_.push_back(letter);
+        if (echo_) {
+            std::cout << letter;
+        }
     }
     return;
 }
@@ -22,4 +25,9 @@ void Serial::write_sc(uint8_t value)
 uint8_t Serial::read_sb()
 {
     return sb_;
+}
+
+void Serial::set_echo(bool echo)
+{
+    echo_ = echo;
 }
\ No newline at end of file
@@ -0,0 +1,413 @@
+#include "sound.h"
+#include <algorithm>
+
+// bits that read back as 1 in 0xff10 - 0xff2f (write-only and unused bits)
+static const std::array<uint8_t, 0x20> read_masks = {
+    0x80, 0x3f, 0x00, 0xff, 0xbf, // NR10 - NR14
+    0xff, 0x3f, 0x00, 0xff, 0xbf, // NR20 (unused) - NR24
+    0x7f, 0xff, 0x9f, 0xff, 0xbf, // NR30 - NR34
+    0xff, 0xff, 0x00, 0x00, 0xbf, // NR40 (unused) - NR44
+    0x00, 0x00, 0x70, // NR50 - NR52
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+};
+
+// the waveforms of the 12.5%, 25%, 50% and 75% duty cycles, one bit per step
+static const std::array<uint8_t, 4> duty_waveforms = {0b00000001, 0b10000001, 0b10000111, 0b01111110};
+
+// the mixed output of all four channels at full volume is 4 * 15 * 8: leave some headroom below full scale
+static const float sample_gain = 32767.0f / (4 * 15 * 8) * 1.5f;
+
+void Sound::set_sample_rate(int sample_rate)
+{
+    catch_up_(time_);
+    producing_ = sample_rate > 0;
+    if (!producing_) {
+        return;
+    }
+    left_.set_rates(clock_rate, sample_rate, time_);
+    right_.set_rates(clock_rate, sample_rate, time_);
+
+    // the waveforms were not stepped without a sample rate: they continue from here
+    for (int channel = 0; channel < 4; channel++) {
+        channels_[channel].next_step = std::max(channels_[channel].next_step, time_);
+    }
+    mixed_ = {0, 0};
+    mix_();
+}
+
+uint8_t Sound::read(uint16_t address, uint64_t cycle)
+{
+    if (address >= 0xff30) {
+        // wave RAM
+        return registers_[address - 0xff10];
+    }
+    if (address == 0xff26) {
+        // the channels' length counters may have run out since the last catch up
+        catch_up_(cycle);
+        status_read_at_ = cycle;
+        uint8_t status = powered_ << 7;
+        for (int channel = 0; channel < 4; channel++) {
+            status |= channels_[channel].enabled << channel;
+        }
+        return status | read_masks[0x16];
+    }
+    return registers_[address - 0xff10] | read_masks[address - 0xff10];
+}
+
+void Sound::write(uint16_t address, uint8_t value, uint64_t cycle)
+{
+    catch_up_(cycle);
+
+    if (address >= 0xff30) {
+        // wave RAM
+        registers_[address - 0xff10] = value;
+        update_output_(2);
+        return;
+    }
+    if (address == 0xff26) {
+        if (powered_ && !(value & 0x80)) {
+            power_off_();
+        }
+        else if (!powered_ && (value & 0x80)) {
+            // the frame sequencer starts over, and the square channels start at the first step of their duty cycle
+            powered_ = true;
+            frame_step_ = 0;
+            channels_[0].position = 0;
+            channels_[1].position = 0;
+        }
+        return;
+    }
+    if (!powered_ || address > 0xff25) {
+        // all registers but NR52 are read-only while the APU is off
+        return;
+    }
+    registers_[address - 0xff10] = value;
+
+    if (address >= 0xff24) {
+        // NR50 / NR51 change the volume or panning of every channel
+        mix_();
+        return;
+    }
+
+    // the four channels have five registers each (NRx0 - NRx4)
+    int channel = (address - 0xff10) / 5;
+    Channel& state = channels_[channel];
+    switch ((address - 0xff10) % 5) {
+        case 0:
+            if (channel == 2) {
+                // NR30: the wave channel's DAC
+                state.dac = value & 0x80;
+                if (!state.dac) {
+                    state.enabled = false;
+                    update_output_(channel);
+                }
+            }
+            break;
+        case 1:
+            // length (and the duty cycle of the square channels, read from the register when stepping)
+            state.length = channel == 2 ? 256 - value : 64 - (value & 0x3f);
+            break;
+        case 2:
+            if (channel == 2) {
+                // NR32: the wave channel's volume
+                update_output_(channel);
+            }
+            else {
+                // envelope: the DAC is off when the initial volume is 0 and the envelope decreases
+                state.dac = value & 0xf8;
+                if (!state.dac) {
+                    state.enabled = false;
+                    update_output_(channel);
+                }
+            }
+            break;
+        case 3:
+            // the low byte of the frequency (NR43 for the noise channel, read from the register when stepping)
+            state.frequency = (state.frequency & 0x700) | value;
+            break;
+        case 4:
+            state.frequency = (state.frequency & 0xff) | ((value & 0x07) << 8);
+            state.length_enabled = value & 0x40;
+            if (value & 0x80) {
+                trigger_(channel);
+            }
+            break;
+    }
+}
+
+void Sound::end_frame(uint64_t cycle)
+{
+    catch_up_(cycle);
+    if (producing_) {
+        left_.end_frame(cycle);
+        right_.end_frame(cycle);
+    }
+}
+
+size_t Sound::read_samples(int16_t* out, size_t count)
+{
+    if (!producing_) {
+        return 0;
+    }
+    left_.read_samples(out, count, 2, sample_gain);
+    return right_.read_samples(out + 1, count, 2, sample_gain);
+}
+
+void Sound::catch_up_(uint64_t cycle)
+{
+    /* Run the APU from time_ to cycle, one frame sequencer step at a time: between steps only the waveforms advance */
+    while (time_ < cycle) {
+        uint64_t step_at = (time_ / frame_step_cycles + 1) * frame_step_cycles;
+        uint64_t end = std::min(cycle, step_at);
+        if (producing_) {
+            for (int channel = 0; channel < 4; channel++) {
+                run_channel_(channel, end);
+            }
+        }
+        time_ = end;
+        if (time_ == step_at && powered_) {
+            clock_frame_sequencer_();
+        }
+    }
+}
+
+void Sound::run_channel_(int channel, uint64_t end)
+{
+    Channel& state = channels_[channel];
+    if (!state.enabled) {
+        return;
+    }
+    if (channel == 3 && (registers_[0x12] >> 4) >= 14) {
+        // the LFSR is not clocked with these shifts
+        state.next_step = std::max(state.next_step, end);
+        return;
+    }
+
+    uint32_t period = period_(channel);
+    while (state.next_step < end) {
+        time_ = state.next_step;
+        switch (channel) {
+            case 0:
+            case 1:
+                state.position = (state.position + 1) & 7;
+                break;
+            case 2:
+                state.position = (state.position + 1) & 31;
+                break;
+            case 3:
+                {
+                    uint16_t bit = (lfsr_ ^ (lfsr_ >> 1)) & 1;
+                    lfsr_ = (lfsr_ >> 1) | (bit << 14);
+                    if (registers_[0x12] & 0x08) {
+                        // 7-bit mode
+                        lfsr_ = (lfsr_ & ~0x40) | (bit << 6);
+                    }
+                }
+                break;
+        }
+        update_output_(channel);
+        state.next_step += period;
+    }
+}
+
+void Sound::clock_frame_sequencer_()
+{
+    /* 256 Hz length counters on even steps, 128 Hz sweep on steps 2 and 6, 64 Hz envelopes on step 7 */
+    if (frame_step_ % 2 == 0) {
+        for (int channel = 0; channel < 4; channel++) {
+            Channel& state = channels_[channel];
+            if (state.length_enabled && state.length > 0 && --state.length == 0) {
+                state.enabled = false;
+                update_output_(channel);
+            }
+        }
+    }
+
+    if (frame_step_ == 2 || frame_step_ == 6) {
+        uint8_t sweep = registers_[0x00];
+        uint8_t sweep_period = (sweep >> 4) & 7;
+        if (sweep_timer_ > 1) {
+            sweep_timer_--;
+        }
+        else {
+            sweep_timer_ = sweep_period ? sweep_period : 8;
+            if (sweep_enabled_ && sweep_period) {
+                uint16_t frequency = sweep_frequency_();
+                if (frequency <= 2047 && (sweep & 0x07)) {
+                    sweep_shadow_ = frequency;
+                    channels_[0].frequency = frequency;
+                    registers_[0x03] = frequency & 0xff;
+                    registers_[0x04] = (registers_[0x04] & ~0x07) | (frequency >> 8);
+                    // the new frequency is checked for overflow again, but not used
+                    sweep_frequency_();
+                }
+            }
+        }
+    }
+
+    if (frame_step_ == 7) {
+        for (int channel : {0, 1, 3}) {
+            Channel& state = channels_[channel];
+            uint8_t envelope = registers_[channel * 5 + 2];
+            uint8_t envelope_period = envelope & 0x07;
+            if (envelope_period == 0) {
+                continue;
+            }
+            if (state.envelope_timer > 1) {
+                state.envelope_timer--;
+                continue;
+            }
+            state.envelope_timer = envelope_period;
+            if ((envelope & 0x08) && state.volume < 15) {
+                state.volume++;
+                update_output_(channel);
+            }
+            else if (!(envelope & 0x08) && state.volume > 0) {
+                state.volume--;
+                update_output_(channel);
+            }
+        }
+    }
+
+    frame_step_ = (frame_step_ + 1) & 7;
+}
+
+void Sound::trigger_(int channel)
+{
+    Channel& state = channels_[channel];
+    state.enabled = state.dac;
+    if (state.length == 0) {
+        state.length = channel == 2 ? 256 : 64;
+    }
+    state.next_step = time_ + period_(channel);
+
+    if (channel == 2) {
+        state.position = 0;
+    }
+    else {
+        uint8_t envelope = registers_[channel * 5 + 2];
+        state.volume = envelope >> 4;
+        state.envelope_timer = envelope & 0x07;
+    }
+    if (channel == 3) {
+        lfsr_ = 0x7fff;
+    }
+    if (channel == 0) {
+        uint8_t sweep = registers_[0x00];
+        sweep_shadow_ = state.frequency;
+        sweep_timer_ = (sweep >> 4) & 7 ? (sweep >> 4) & 7 : 8;
+        sweep_enabled_ = sweep & 0x77;
+        if (sweep & 0x07) {
+            sweep_frequency_();
+        }
+    }
+    update_output_(channel);
+}
+
+uint16_t Sound::sweep_frequency_()
+{
+    uint8_t sweep = registers_[0x00];
+    uint16_t change = sweep_shadow_ >> (sweep & 0x07);
+    uint16_t frequency = (sweep & 0x08) ? sweep_shadow_ - change : sweep_shadow_ + change;
+    if (frequency > 2047) {
+        channels_[0].enabled = false;
+        update_output_(0);
+    }
+    return frequency;
+}
+
+uint32_t Sound::period_(int channel)
+{
+    switch (channel) {
+        case 0:
+        case 1:
+            return (2048 - channels_[channel].frequency) * 4;
+        case 2:
+            return (2048 - channels_[channel].frequency) * 2;
+        default:
+            {
+                // NR43: divisor code in bits 0 - 2 (0 means 8, else 16 per step), clock shift in bits 4 - 7
+                uint8_t noise = registers_[0x12];
+                uint32_t divisor = (noise & 0x07) ? (noise & 0x07) * 16 : 8;
+                return divisor << (noise >> 4);
+            }
+    }
+}
+
+uint8_t Sound::sample_(int channel)
+{
+    const Channel& state = channels_[channel];
+    if (!state.enabled) {
+        return 0;
+    }
+    switch (channel) {
+        case 0:
+        case 1:
+            {
+                uint8_t duty = registers_[channel * 5 + 1] >> 6;
+                return (duty_waveforms[duty] >> state.position) & 1 ? state.volume : 0;
+            }
+        case 2:
+            {
+                // two 4-bit samples per byte of wave RAM, high nibble first, shifted right by the NR32 volume
+                static const uint8_t volume_shifts[] = {4, 0, 1, 2};
+                uint8_t sample = registers_[0x20 + state.position / 2];
+                sample = state.position & 1 ? sample & 0x0f : sample >> 4;
+                return sample >> volume_shifts[(registers_[0x0c] >> 5) & 3];
+            }
+        default:
+            return lfsr_ & 1 ? 0 : state.volume;
+    }
+}
+
+void Sound::update_output_(int channel)
+{
+    uint8_t output = sample_(channel);
+    if (output != channels_[channel].output) {
+        channels_[channel].output = output;
+        mix_();
+    }
+}
+
+void Sound::mix_()
+{
+    /* NR51 routes each channel to the left (bits 4 - 7) and / or right (bits 0 - 3) output, NR50 sets the volume of each
+    side (1 - 8) */
+    if (!producing_) {
+        return;
+    }
+    uint8_t panning = registers_[0x15];
+    uint8_t volume = registers_[0x14];
+    std::array<int, 2> mixed = {0, 0};
+    for (int channel = 0; channel < 4; channel++) {
+        if (panning & (0x10 << channel)) {
+            mixed[0] += channels_[channel].output;
+        }
+        if (panning & (0x01 << channel)) {
+            mixed[1] += channels_[channel].output;
+        }
+    }
+    mixed[0] *= ((volume >> 4) & 7) + 1;
+    mixed[1] *= (volume & 7) + 1;
+
+    if (mixed[0] != mixed_[0]) {
+        left_.add_step(time_, mixed[0] - mixed_[0]);
+    }
+    if (mixed[1] != mixed_[1]) {
+        right_.add_step(time_, mixed[1] - mixed_[1]);
+    }
+    mixed_ = mixed;
+}
+
+void Sound::power_off_()
+{
+    /* Turning the APU off clears every register but wave RAM, and stops all channels */
+    powered_ = false;
+    std::fill(registers_.begin(), registers_.begin() + 0x16, 0);
+    for (int channel = 0; channel < 4; channel++) {
+        channels_[channel] = Channel();
+        channels_[channel].next_step = time_;
+    }
+    sweep_enabled_ = false;
+    mix_();
+}
\ No newline at end of file
@@ -0,0 +1,120 @@
+#include "stats.h"
+#include "interrupts.h"
+#include <algorithm>
+#include <bit>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <string>
+
+// names of the MMIO registers, for the register table
+static const std::map<uint8_t, const char*> io_names = {
+    {0x00, "P1/JOYP"}, {0x01, "SB"}, {0x02, "SC"}, {0x04, "DIV"}, {0x05, "TIMA"}, {0x06, "TMA"}, {0x07, "TAC"},
+    {0x0f, "IF"}, {0x10, "NR10"}, {0x11, "NR11"}, {0x12, "NR12"}, {0x13, "NR13"}, {0x14, "NR14"}, {0x16, "NR21"},
+    {0x17, "NR22"}, {0x18, "NR23"}, {0x19, "NR24"}, {0x1a, "NR30"}, {0x1b, "NR31"}, {0x1c, "NR32"}, {0x1d, "NR33"},
+    {0x1e, "NR34"}, {0x20, "NR41"}, {0x21, "NR42"}, {0x22, "NR43"}, {0x23, "NR44"}, {0x24, "NR50"}, {0x25, "NR51"},
+    {0x26, "NR52"}, {0x40, "LCDC"}, {0x41, "STAT"}, {0x42, "SCY"}, {0x43, "SCX"}, {0x44, "LY"}, {0x45, "LYC"},
+    {0x46, "DMA"}, {0x47, "BGP"}, {0x48, "OBP0"}, {0x49, "OBP1"}, {0x4a, "WY"}, {0x4b, "WX"}, {0x50, "BOOT"},
+    {0xff, "IE"}
+};
+
+template <typename Row>
+static void sort_descending(std::vector<Row>& rows)
+{
+    std::sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) { return a.first > b.first; });
+}
+
+void Stats::write_report(std::ostream& out)
+{
+    uint64_t instructions = 0;
+    for (uint64_t count : opcodes) {
+        instructions += count;
+    }
+    auto percent = [&](uint64_t count, uint64_t total) { return total ? 100.0 * count / total : 0.0; };
+    auto hex = [](unsigned int value, int width) {
+        std::stringstream stream;
+        stream << std::hex << std::setfill('0') << std::setw(width) << value;
+        return stream.str();
+    };
+
+    out << std::fixed << std::setprecision(2);
+    out << "Instructions executed: " << instructions << "\n\n";
+
+    // opcodes, most frequent first
+    std::vector<std::pair<uint64_t, std::string>> rows;
+    for (int opcode = 0; opcode < 256; opcode++) {
+        if (opcodes[opcode] > 0) {
+            rows.push_back({opcodes[opcode], hex(opcode, 2)});
+        }
+        if (cb_opcodes[opcode] > 0) {
+            rows.push_back({cb_opcodes[opcode], "cb " + hex(opcode, 2)});
+        }
+    }
+    sort_descending(rows);
+    out << "Opcodes:\n";
+    for (const auto& [count, name] : rows) {
+        out << std::setw(8) << name << std::setw(16) << count << std::setw(8) << percent(count, instructions) << "%\n";
+    }
+
+    // the most frequent pairs are the candidates for superinstructions
+    rows.clear();
+    for (int pair = 0; pair < 256 * 256; pair++) {
+        if (opcode_pairs[pair] > 0) {
+            rows.push_back({opcode_pairs[pair], hex(pair >> 8, 2) + " " + hex(pair & 0xff, 2)});
+        }
+    }
+    sort_descending(rows);
+    rows.resize(std::min<size_t>(rows.size(), 50));
+    out << "\nOpcode pairs (top 50):\n";
+    for (const auto& [count, name] : rows) {
+        out << std::setw(8) << name << std::setw(16) << count << std::setw(8) << percent(count, instructions) << "%\n";
+    }
+
+    out << "\nConditional branches:\n";
+    for (int opcode = 0; opcode < 256; opcode++) {
+        uint64_t total = branches_taken[opcode] + branches_not_taken[opcode];
+        if (total > 0) {
+            out << std::setw(8) << hex(opcode, 2) << std::setw(16) << branches_taken[opcode] << " taken" << std::setw(16)
+                << branches_not_taken[opcode] << " not taken" << std::setw(8) << percent(branches_taken[opcode], total) << "% taken\n";
+        }
+    }
+
+    out << "\nInterrupts dispatched:\n";
+    for (int interrupt = 0; interrupt < 5; interrupt++) {
+        out << std::setw(8) << InterruptController::names[interrupt] << std::setw(16) << interrupts[interrupt] << "\n";
+    }
+
+    // the decode cache would need an entry per executed address
+    out << "\nDistinct instruction addresses executed:\n";
+    for (size_t bank = 0; bank < executed.size() / (0x10000 / 8); bank++) {
+        uint64_t addresses = 0;
+        for (size_t byte = bank * (0x10000 / 8); byte < (bank + 1) * (0x10000 / 8); byte++) {
+            addresses += std::popcount(executed[byte]);
+        }
+        if (addresses > 0) {
+            out << std::setw(8) << ("bank " + std::to_string(bank)) << std::setw(16) << addresses << "\n";
+        }
+    }
+
+    out << "\nMemory pages (reads / writes):\n";
+    for (int page = 0; page < 256; page++) {
+        if (page_reads[page] + page_writes[page] > 0) {
+            out << std::setw(8) << (hex(page, 2) + "xx") << std::setw(16) << page_reads[page] << std::setw(16) << page_writes[page] << "\n";
+        }
+    }
+
+    out << "\nMMIO registers (reads / writes):\n";
+    rows.clear();
+    for (int reg = 0; reg < 256; reg++) {
+        if ((reg < 0x80 || reg == 0xff) && io_reads[reg] + io_writes[reg] > 0) {
+            rows.push_back({io_reads[reg] + io_writes[reg], hex(reg, 2)});
+        }
+    }
+    sort_descending(rows);
+    for (const auto& [count, name] : rows) {
+        uint8_t reg = std::stoi(name, nullptr, 16);
+        std::string label = "ff" + name + (io_names.contains(reg) ? std::string(" ") + io_names.at(reg) : "");
+        out << std::setw(14) << std::left << label << std::right << std::setw(16) << io_reads[reg] << std::setw(16) << io_writes[reg] << "\n";
+    }
+    out << std::flush;
+}
\ No newline at end of file
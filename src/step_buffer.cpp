@@ -0,0 +1,96 @@
+#include "step_buffer.h"
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#ifdef __SSE2__
+#include <immintrin.h>
+#endif
+
+StepBuffer::StepBuffer()
+{
+    /* Tabulate the step for every phase: a Blackman windowed sinc impulse centred kernel_width / 2 samples after the
+    step, cut off a little below the Nyquist frequency. Each phase is normalised to a sum of 1, so a step of delta
+    changes the summed signal by exactly delta */
+    const double cutoff = 0.9;
+    const double half = kernel_width / 2;
+    for (int phase = 0; phase < phases; phase++) {
+        double centre = half + static_cast<double>(phase) / phases;
+        double sum = 0;
+        std::array<double, kernel_width> taps;
+        for (int tap = 0; tap < kernel_width; tap++) {
+            double x = tap - centre;
+            double sinc = x == 0 ? 1 : std::sin(std::numbers::pi * cutoff * x) / (std::numbers::pi * cutoff * x);
+            double window = std::abs(x) >= half ? 0 : 0.42 + 0.5 * std::cos(std::numbers::pi * x / half) + 0.08 * std::cos(2 * std::numbers::pi * x / half);
+            taps[tap] = sinc * window;
+            sum += taps[tap];
+        }
+        for (int tap = 0; tap < kernel_width; tap++) {
+            kernel_[phase][tap] = taps[tap] / sum;
+        }
+    }
+}
+
+void StepBuffer::set_rates(double clock_rate, int sample_rate, uint64_t cycle)
+{
+    nominal_samples_per_cycle_ = sample_rate / clock_rate;
+    samples_per_cycle_ = nominal_samples_per_cycle_;
+    // the DC blocker follows the average with a time constant of about 50 ms
+    dc_rate_ = 1 - std::exp(-1.0 / (0.05 * sample_rate));
+    deltas_.assign(sample_rate / 10 + kernel_width, 0);
+    start_cycle_ = cycle;
+    available_ = 0;
+    sum_ = 0;
+    dc_ = 0;
+}
+
+void StepBuffer::add_step(uint64_t cycle, int delta)
+{
+    double position = (cycle - start_cycle_) * samples_per_cycle_;
+    size_t index = static_cast<size_t>(position);
+    int phase = static_cast<int>((position - index) * phases);
+    if (index + kernel_width > deltas_.size()) {
+        // the samples were not read for a while
+        deltas_.resize(index + kernel_width, 0);
+    }
+
+    const float* kernel = kernel_[phase].data();
+    float* deltas = &deltas_[index];
+#ifdef __SSE2__
+    // four taps at a time (the kernel rows are aligned, the buffer position is not)
+    __m128 size = _mm_set1_ps(static_cast<float>(delta));
+    for (int tap = 0; tap < kernel_width; tap += 4) {
+        _mm_storeu_ps(deltas + tap, _mm_add_ps(_mm_loadu_ps(deltas + tap), _mm_mul_ps(size, _mm_load_ps(kernel + tap))));
+    }
+#else
+    for (int tap = 0; tap < kernel_width; tap++) {
+        deltas[tap] += delta * kernel[tap];
+    }
+#endif
+}
+
+void StepBuffer::end_frame(uint64_t cycle)
+{
+    // a step added from now on only touches the samples from the one at cycle on
+    available_ = static_cast<size_t>((cycle - start_cycle_) * samples_per_cycle_);
+    if (available_ + kernel_width > deltas_.size()) {
+        deltas_.resize(available_ + kernel_width, 0);
+    }
+}
+
+size_t StepBuffer::read_samples(int16_t* out, size_t count, int stride, float gain)
+{
+    count = std::min(count, available_);
+    for (size_t sample = 0; sample < count; sample++) {
+        sum_ += deltas_[sample];
+        dc_ += (sum_ - dc_) * dc_rate_;
+        float value = (sum_ - dc_) * gain;
+        out[sample * stride] = static_cast<int16_t>(std::clamp(value, -32768.0f, 32767.0f));
+    }
+
+    // move the samples still being added to to the front
+    std::copy(deltas_.begin() + count, deltas_.end(), deltas_.begin());
+    std::fill(deltas_.end() - count, deltas_.end(), 0.0f);
+    start_cycle_ += count / samples_per_cycle_;
+    available_ -= count;
+    return count;
+}
\ No newline at end of file
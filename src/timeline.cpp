@@ -0,0 +1,138 @@
+#include "timeline.h"
+#include "cpu.h"
+#include <cstdio>
+#include <iostream>
+
+static const char* track_names[] = {"frames", "presentation", "CPU", "interrupts", "PPU mode", "LCD registers", "OAM DMA", "MBC"};
+
+Timeline::Timeline(std::string timeline_file, ::CPU* cpu) : cpu_(cpu), host_start_(std::chrono::steady_clock::now()), chunks_(chunk_count)
+{
+    timeline_writer_.open(timeline_file, std::ios::trunc);
+
+    if (!timeline_writer_) {
+        std::cout << "Error: could not open the timeline file." << std::endl;
+        exit(-1);
+    }
+
+    // every chunk is allocated up front
+    for (Chunk& chunk : chunks_) {
+        chunk.reserve(chunk_size);
+        free_chunks_.push_back(&chunk);
+    }
+    for (Chunk*& current : current_) {
+        current = free_chunks_.back();
+        free_chunks_.pop_back();
+    }
+
+    // name the processes and tracks
+    timeline_writer_ << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    timeline_writer_ << "{\"ph\":\"M\",\"pid\":1,\"name\":\"process_name\",\"args\":{\"name\":\"Host\"}},\n";
+    timeline_writer_ << "{\"ph\":\"M\",\"pid\":2,\"name\":\"process_name\",\"args\":{\"name\":\"Game Boy (emulated time)\"}}";
+    for (int track = 0; track < track_count; track++) {
+        timeline_writer_ << ",\n{\"ph\":\"M\",\"pid\":" << (track < first_emulated_track ? 1 : 2) << ",\"tid\":" << track
+                         << ",\"name\":\"thread_name\",\"args\":{\"name\":\"" << track_names[track] << "\"}}";
+    }
+
+    writer_thread_ = std::thread(&Timeline::write_events, this);
+}
+
+Timeline::~Timeline()
+{
+    // close the open state spans, then hand the last chunk over and wait for everything to be written
+    for (int track = 0; track < track_count; track++) {
+        if (state_name_[track]) {
+            state(static_cast<Track>(track), nullptr);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        full_chunks_.insert(full_chunks_.end(), current_.begin(), current_.end());
+        stop_ = true;
+    }
+    full_.notify_one();
+    writer_thread_.join();
+
+    timeline_writer_ << "\n],\"otherData\":{\"dropped_events\":" << dropped_.load() << "}}\n";
+    timeline_writer_.close();
+
+    if (dropped_ > 0) {
+        std::cout << "Warning: the timeline writer fell behind, " << dropped_.load() << " events were dropped." << std::endl;
+    }
+}
+
+uint64_t Timeline::now_(Track track)
+{
+    if (track < first_emulated_track) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - host_start_).count();
+    }
+    return cpu_->cycle_count();
+}
+
+void Timeline::state(Track track, const char* name)
+{
+    if (name == state_name_[track]) {
+        return; // still in the same state
+    }
+    uint64_t time = now_(track);
+    if (state_name_[track]) {
+        span(track, state_name_[track], state_start_[track], time);
+    }
+    state_name_[track] = name;
+    state_start_[track] = time;
+}
+
+bool Timeline::next_chunk_(Chunk*& current)
+{
+    /* only called once every chunk_size events, so the lock is not a cost */
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (free_chunks_.empty()) {
+            return false;
+        }
+        full_chunks_.push_back(current);
+        current = free_chunks_.back();
+        free_chunks_.pop_back();
+    }
+    full_.notify_one();
+    return true;
+}
+
+void Timeline::write_events()
+{
+    char line[256];
+    while (true) {
+        Chunk* chunk;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            full_.wait(lock, [&] { return stop_ || !full_chunks_.empty(); });
+            if (full_chunks_.empty()) {
+                return;
+            }
+            chunk = full_chunks_.front();
+            full_chunks_.erase(full_chunks_.begin());
+        }
+
+        for (const Event& event : *chunk) {
+            // host times are in nanoseconds, emulated times in master clock cycles; the JSON wants microseconds
+            bool host = event.track < first_emulated_track;
+            double scale = host ? 1.0 / 1000.0 : 1.0 / 4.194304;
+            int length = snprintf(line, sizeof(line), ",\n{\"ph\":\"%c\",\"pid\":%d,\"tid\":%d,\"name\":\"%s\",\"ts\":%.3f",
+                                  event.phase, host ? 1 : 2, event.track, event.name, event.time * scale);
+            if (event.phase == 'X') {
+                length += snprintf(line + length, sizeof(line) - length, ",\"dur\":%.3f", event.duration * scale);
+            }
+            else {
+                length += snprintf(line + length, sizeof(line) - length, ",\"s\":\"t\"");
+            }
+            if (event.arg >= 0) {
+                length += snprintf(line + length, sizeof(line) - length, ",\"args\":{\"value\":%d}", event.arg);
+            }
+            length += snprintf(line + length, sizeof(line) - length, "}");
+            timeline_writer_.write(line, length);
+        }
+
+        chunk->clear();
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_chunks_.push_back(chunk);
+    }
+}
\ No newline at end of file
@@ -1,10 +1,10 @@
 #include "timers.h"
-#include "bus.h"
+#include <algorithm>
 #include <cstdint>
 
-void Timers::connect_bus(Bus *bus)
+void Timers::connect_interrupts(InterruptController* interrupts)
 {
-    bus_ = bus;
+    interrupts_ = interrupts;
 }
 
 void Timers::increment_cycle_counter()
@@ -73,6 +73,53 @@ void Timers::increment_cycle_counter()
     }
 }
 
+uint8_t Timers::selected_div_bit()
+{
+    static const uint8_t bits[] = {9, 3, 5, 7};
+    return bits[tac_ & 0b11];
+}
+
+uint32_t Timers::idle_cycles()
+{
+    /* TIMA is incremented on the falling edge of the selected DIV bit (while enabled), and every clock period by the cycle counter.
+    Until the first of those, a cycle only increments the counters */
+    uint8_t timer_enable = (tac_ & 0b100) >> 2;
+    if (!timer_enable) {
+        // disabling the timer while the selected bit is high is a falling edge on the next cycle
+        return prev_cycle_AND_result ? 0 : UINT32_MAX;
+    }
+
+    // the falling edge comes when the bits up to the selected one all roll over to 0, and the clock period is the same length
+    uint32_t period = 1 << (selected_div_bit() + 1);
+    uint32_t to_falling_edge = period - (div_ & (period - 1));
+    uint32_t to_period_end = period - (t_cycle_counter % period);
+    return std::min(to_falling_edge, to_period_end) - 1;
+}
+
+uint32_t Timers::steady_cycles(bool div)
+{
+    return div ? std::min<uint32_t>(idle_cycles(), 0xff - (div_ & 0xff)) : idle_cycles();
+}
+
+uint32_t Timers::quiet_cycles(bool div)
+{
+    // both TIMA increments and DIV changes come at the rollover of the low bits of the counters
+    uint32_t quiet = div ? div_ & 0xff : UINT32_MAX;
+    if (tac_ & 0b100) {
+        uint32_t period = 1 << (selected_div_bit() + 1);
+        quiet = std::min({quiet, static_cast<uint32_t>(div_ & (period - 1)), static_cast<uint32_t>(t_cycle_counter % period)});
+    }
+    return quiet;
+}
+
+void Timers::skip(uint32_t cycles)
+{
+    t_cycle_counter += cycles;
+    div_ += cycles;
+    uint8_t timer_enable = (tac_ & 0b100) >> 2;
+    prev_cycle_AND_result = ((div_ >> selected_div_bit()) & 1) & timer_enable;
+}
+
 void Timers::increment_tima()
 {
     if (tima_overflow_count == 0) {
@@ -89,9 +136,7 @@ void Timers::increment_tima()
     if (tima_overflow_count > 0) {
         tima_overflow_count--;
         if (tima_overflow_count == 0) {
-            uint8_t interrupt_flag = bus_->read(0xff0f);
-            interrupt_flag |= (1 << 2); // update the timer flag IF
-            bus_->write(0xff0f, interrupt_flag); 
+            interrupts_->request(InterruptController::Timer);
             tima_ = tma_;
         }
     }
@@ -153,6 +198,7 @@ void Timers::write_tima(uint8_t value)
 
 uint8_t Timers::read_div()
 {
+    div_read_at_ = t_cycle_counter;
     return div_ >> 8;
 }
 uint8_t Timers::read_tima()
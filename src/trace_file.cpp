@@ -0,0 +1,106 @@
+#include "trace_file.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+TraceFile::TraceFile(std::string trace_file)
+{
+    int fd = open(trace_file.c_str(), O_RDONLY);
+    struct stat file_stat;
+    if (fd < 0 || fstat(fd, &file_stat) != 0 || static_cast<size_t>(file_stat.st_size) < sizeof(TraceHeader)) {
+        std::cout << "Error: could not open the trace file " << trace_file << std::endl;
+        exit(-1);
+    }
+
+    map_size_ = file_stat.st_size;
+    map_ = mmap(nullptr, map_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map_ == MAP_FAILED) {
+        std::cout << "Error: could not map the trace file " << trace_file << std::endl;
+        exit(-1);
+    }
+
+    const uint8_t* bytes = static_cast<const uint8_t*>(map_);
+    const TraceHeader* header = reinterpret_cast<const TraceHeader*>(bytes);
+    if (std::memcmp(header->magic, trace_magic, sizeof(trace_magic)) != 0 || header->record_size != sizeof(TraceRecord)) {
+        std::cout << "Error: " << trace_file << " is not a trace file." << std::endl;
+        exit(-1);
+    }
+
+    records_ = reinterpret_cast<const TraceRecord*>(bytes + sizeof(TraceHeader));
+
+    // a properly closed trace ends with a trailer that holds the record count and the cycle index
+    const TraceTrailer* trailer = reinterpret_cast<const TraceTrailer*>(bytes + map_size_ - sizeof(TraceTrailer));
+    if (map_size_ >= sizeof(TraceHeader) + sizeof(TraceTrailer) && std::memcmp(trailer->magic, trace_index_magic, sizeof(trace_index_magic)) == 0) {
+        record_count_ = trailer->record_count;
+        index_ = reinterpret_cast<const TraceIndexEntry*>(bytes + trailer->index_offset);
+        index_entries_ = trailer->index_entries;
+    }
+    else {
+        // the trace was cut short: every complete record is still usable
+        record_count_ = (map_size_ - sizeof(TraceHeader)) / sizeof(TraceRecord);
+        std::cout << "Warning: " << trace_file << " has no index, it was not closed properly." << std::endl;
+    }
+
+    // the trace is read front to back by most tools
+    madvise(map_, map_size_, MADV_SEQUENTIAL);
+}
+
+TraceFile::~TraceFile()
+{
+    munmap(map_, map_size_);
+}
+
+uint64_t TraceFile::find_cycle(uint64_t cycle) const
+{
+    // narrow the search down with the index first (if there is one), so only a few pages of records are touched
+    uint64_t low = 0;
+    uint64_t high = record_count_;
+    if (index_) {
+        const TraceIndexEntry* entry = std::upper_bound(index_, index_ + index_entries_, cycle, [](uint64_t c, const TraceIndexEntry& e) { return c <= e.cycle; });
+        if (entry != index_) {
+            low = std::prev(entry)->record;
+        }
+        if (entry != index_ + index_entries_) {
+            high = std::min(high, entry->record + 1);
+        }
+    }
+
+    const TraceRecord* record = std::lower_bound(records_ + low, records_ + high, cycle, [](const TraceRecord& r, uint64_t c) { return r.cycle < c; });
+    return record - records_;
+}
+
+size_t format_doctor_line(const TraceRecord& record, char* out)
+{
+    static const char digits[] = "0123456789ABCDEF";
+    char* p = out;
+
+    auto put_text = [&](const char* text) { while (*text) { *p++ = *text++; } };
+    auto put_hex = [&](uint16_t value, int width) {
+        for (int shift = (width - 1) * 4; shift >= 0; shift -= 4) {
+            *p++ = digits[(value >> shift) & 0xf];
+        }
+    };
+
+    put_text("A:"); put_hex(record.af >> 8, 2);
+    put_text(" F:"); put_hex(record.af & 0xff, 2);
+    put_text(" B:"); put_hex(record.bc >> 8, 2);
+    put_text(" C:"); put_hex(record.bc & 0xff, 2);
+    put_text(" D:"); put_hex(record.de >> 8, 2);
+    put_text(" E:"); put_hex(record.de & 0xff, 2);
+    put_text(" H:"); put_hex(record.hl >> 8, 2);
+    put_text(" L:"); put_hex(record.hl & 0xff, 2);
+    put_text(" SP:"); put_hex(record.sp, 4);
+    put_text(" PC:"); put_hex(record.pc, 4);
+    put_text(" PCMEM:"); put_hex(record.opcode[0], 2);
+    for (int i = 1; i < 4; i++) {
+        *p++ = ',';
+        put_hex(record.opcode[i], 2);
+    }
+
+    return p - out;
+}
\ No newline at end of file
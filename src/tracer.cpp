@@ -0,0 +1,75 @@
+#include "tracer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+Tracer::Tracer(std::string trace_file) : ring_(std::make_unique<TraceRecord[]>(ring_size))
+{
+    trace_writer_.open(trace_file, std::ios::binary | std::ios::trunc);
+
+    if (!trace_writer_) {
+        throw std::runtime_error("could not open the trace file " + trace_file + ".");
+    }
+
+    TraceHeader header;
+    std::memcpy(header.magic, trace_magic, sizeof(header.magic));
+    header.version = 1;
+    header.record_size = sizeof(TraceRecord);
+    trace_writer_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    writer_thread_ = std::thread(&Tracer::write_records, this);
+}
+
+Tracer::~Tracer()
+{
+    // the writer drains everything recorded so far before it stops
+    stop_.store(true, std::memory_order_release);
+    writer_thread_.join();
+
+    // write the cycle index and the trailer pointing to it
+    TraceTrailer trailer;
+    trailer.index_offset = static_cast<uint64_t>(trace_writer_.tellp());
+    trailer.index_entries = index_.size();
+    trailer.record_count = tail_.load();
+    std::memcpy(trailer.magic, trace_index_magic, sizeof(trailer.magic));
+
+    trace_writer_.write(reinterpret_cast<const char*>(index_.data()), index_.size() * sizeof(TraceIndexEntry));
+    trace_writer_.write(reinterpret_cast<const char*>(&trailer), sizeof(trailer));
+    trace_writer_.close();
+}
+
+void Tracer::write_records()
+{
+    while (true) {
+        // read stop_ before head_, so that nothing recorded before the stop request can be missed
+        bool stopping = stop_.load(std::memory_order_acquire);
+        uint64_t head = head_.load(std::memory_order_acquire);
+        uint64_t tail = tail_.load(std::memory_order_relaxed);
+
+        if (head == tail) {
+            if (stopping) {
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+
+        // every trace_index_interval'th record goes into the index
+        for (uint64_t record = (tail + trace_index_interval - 1) / trace_index_interval * trace_index_interval; record < head; record += trace_index_interval) {
+            index_.push_back({ring_[record & (ring_size - 1)].cycle, record});
+        }
+
+        // write the records in (at most) two contiguous pieces, since they can wrap around the end of the ring
+        while (tail < head) {
+            uint64_t start = tail & (ring_size - 1);
+            uint64_t count = std::min(head - tail, ring_size - start);
+            trace_writer_.write(reinterpret_cast<const char*>(&ring_[start]), count * sizeof(TraceRecord));
+            tail += count;
+        }
+
+        // hand the space back to the CPU
+        tail_.store(tail, std::memory_order_release);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,271 @@
+/*
+audio.cpp: render a ROM's sound headless, as fast as the host can emulate it.
+
+Usage:
+    gameboy-audio <rom> --frames N [--out file] [--raw] [--rate 44100|48000] [--movie file] [--bootrom file]
+                  [--block samples] [--hashes file] [--check file]
+
+Runs the ROM (replaying the movie, if any) for N frames without a window or audio device, and writes the APU's output as
+16-bit stereo: a WAV file, or raw little-endian PCM with --raw. --out - writes to stdout, so the samples can be piped
+into another program (a WAV written to a pipe has its sizes set to 0xffffffff, as the header cannot be patched
+afterwards). The samples are synthesized band-limited at the output rate (see step_buffer.h), so there is no separate
+resampling pass.
+
+--hashes writes the XXH64 hash of every block of --block stereo samples (4096 by default, the last one may be shorter)
+to a file, one per line; --check compares the run against such a file and reports the first block that differs, for
+audio regression tests. The synthesis uses floating point, so hashes are only comparable between builds made with the
+same compiler and flags.
+
+Exits with 0 on success, and 1 if a check failed.
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "gameboy.h"
+#include "hash.h"
+#include "movie.h"
+
+struct Options {
+    std::string bootrom;
+    std::string movie;
+    std::string out;
+    std::string hashes;
+    std::string check;
+    uint64_t frames = 0;
+    int rate = 48000;
+    size_t block = 4096;
+    bool raw = false;
+};
+
+static std::string hex(uint64_t value)
+{
+    std::stringstream stream;
+    stream << std::hex << std::setfill('0') << std::setw(16) << value;
+    return stream.str();
+}
+
+class AudioWriter {
+    /* writes the samples as raw PCM, or as a WAV file whose sizes are filled in at the end (if the file can seek) */
+    public:
+        AudioWriter(const std::string& path, bool raw, int rate) : raw_(raw), rate_(rate)
+        {
+            if (path == "-") {
+                file_ = stdout;
+            }
+            else {
+                file_ = std::fopen(path.c_str(), "wb");
+                if (!file_) {
+                    throw std::runtime_error("could not open " + path + ".");
+                }
+            }
+            if (!raw_) {
+                write_header_(0xffffffff);
+            }
+        };
+
+        void write(const int16_t* samples, size_t count)
+        {
+            std::fwrite(samples, sizeof(int16_t), 2 * count, file_);
+            bytes_ += 4 * count;
+        };
+
+        ~AudioWriter()
+        {
+            // a pipe cannot seek, it keeps the unknown sizes
+            if (!raw_ && std::fseek(file_, 0, SEEK_SET) == 0) {
+                write_header_(bytes_);
+            }
+            if (file_ != stdout) {
+                std::fclose(file_);
+            }
+            else {
+                std::fflush(file_);
+            }
+        };
+
+    private:
+        void write_header_(uint64_t data_bytes)
+        {
+            uint32_t data = data_bytes >= 0xffffffff - 36 ? 0xffffffff : static_cast<uint32_t>(data_bytes);
+            uint32_t riff = data == 0xffffffff ? 0xffffffff : data + 36;
+            auto u32 = [&](uint32_t value) { uint8_t bytes[] = {uint8_t(value), uint8_t(value >> 8), uint8_t(value >> 16), uint8_t(value >> 24)}; std::fwrite(bytes, 1, 4, file_); };
+            auto u16 = [&](uint16_t value) { uint8_t bytes[] = {uint8_t(value), uint8_t(value >> 8)}; std::fwrite(bytes, 1, 2, file_); };
+
+            std::fwrite("RIFF", 1, 4, file_);
+            u32(riff);
+            std::fwrite("WAVEfmt ", 1, 8, file_);
+            u32(16); // size of the fmt chunk
+            u16(1); // PCM
+            u16(2); // channels
+            u32(rate_);
+            u32(rate_ * 4); // bytes per second
+            u16(4); // bytes per sample frame
+            u16(16); // bits per sample
+            std::fwrite("data", 1, 4, file_);
+            u32(data);
+        };
+
+        std::FILE* file_;
+        bool raw_;
+        int rate_;
+        uint64_t bytes_ = 0;
+};
+
+static int render(const std::string& rom, const Options& options)
+{
+    std::vector<uint64_t> expected;
+    if (!options.check.empty()) {
+        std::ifstream hashes(options.check);
+        if (!hashes) {
+            std::cout << "Error: could not open " << options.check << std::endl;
+            return 1;
+        }
+        uint64_t hash;
+        while (hashes >> std::hex >> hash) {
+            expected.push_back(hash);
+        }
+    }
+
+    std::unique_ptr<GameBoy> loaded = load_or_exit(options.bootrom, rom, true);
+    GameBoy& gameboy = *loaded;
+    gameboy.sound().set_sample_rate(options.rate);
+    gameboy.set_rendering(false); // only the sound is looked at
+    Movie movie;
+    if (!options.movie.empty()) {
+        load_or_exit([&]() { movie.load_movie_from_file(options.movie); });
+    }
+
+    std::unique_ptr<AudioWriter> writer;
+    if (!options.out.empty()) {
+        writer = load_or_exit([&]() { return std::make_unique<AudioWriter>(options.out, options.raw, options.rate); });
+    }
+    std::ofstream hashes;
+    if (!options.hashes.empty()) {
+        hashes.open(options.hashes);
+    }
+
+    // samples are hashed in blocks of the same size however the frames split them
+    std::vector<int16_t> samples;
+    std::vector<int16_t> block;
+    uint64_t blocks = 0;
+    auto end_block = [&]() {
+        uint64_t hash = hash::xxh64(block.data(), block.size() * sizeof(int16_t));
+        if (hashes.is_open()) {
+            hashes << hex(hash) << '\n';
+        }
+        if (!expected.empty() && (blocks >= expected.size() || hash != expected[blocks])) {
+            double seconds = static_cast<double>(blocks * options.block) / options.rate;
+            std::cout << "FAIL " << rom << ": block " << blocks << " (at " << std::fixed << std::setprecision(3) << seconds
+                      << " s) differs (expected " << (blocks < expected.size() ? hex(expected[blocks]) : "no block") << ", got " << hex(hash) << ")" << std::endl;
+            return false;
+        }
+        blocks++;
+        block.clear();
+        return true;
+    };
+
+    for (uint64_t frame = 0; frame < options.frames; frame++) {
+        if (!options.movie.empty()) {
+            gameboy.set_input(movie.input_for_frame(frame));
+        }
+        gameboy.run_frame();
+
+        Sound& sound = gameboy.sound();
+        samples.resize(2 * sound.samples_available());
+        size_t count = sound.read_samples(samples.data(), sound.samples_available());
+        if (writer) {
+            writer->write(samples.data(), count);
+        }
+        for (size_t sample = 0; sample < count; sample++) {
+            block.push_back(samples[2 * sample]);
+            block.push_back(samples[2 * sample + 1]);
+            if (block.size() == 2 * options.block && !end_block()) {
+                return 1;
+            }
+        }
+    }
+    if (!block.empty() && !end_block()) {
+        return 1;
+    }
+
+    if (!expected.empty()) {
+        if (blocks != expected.size()) {
+            std::cout << "FAIL " << rom << ": " << blocks << " blocks, expected " << expected.size() << std::endl;
+            return 1;
+        }
+        std::cout << "PASS " << rom << " (" << blocks << " blocks)" << std::endl;
+    }
+    return 0;
+}
+
+static void print_usage()
+{
+    std::cout << "Usage:\n"
+              << "    gameboy-audio <rom> --frames N [--out file] [--raw] [--rate 44100|48000] [--movie file] [--bootrom file]\n"
+              << "                  [--block samples] [--hashes file] [--check file]" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2) {
+        print_usage();
+        exit(-1);
+    }
+
+    std::string rom = argv[1];
+    Options options;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--frames" && i + 1 < argc) {
+            options.frames = std::stoull(argv[++i]);
+        }
+        else if (arg == "--out" && i + 1 < argc) {
+            options.out = argv[++i];
+        }
+        else if (arg == "--raw") {
+            options.raw = true;
+        }
+        else if (arg == "--rate" && i + 1 < argc) {
+            options.rate = std::stoi(argv[++i]);
+        }
+        else if (arg == "--movie" && i + 1 < argc) {
+            options.movie = argv[++i];
+        }
+        else if (arg == "--bootrom" && i + 1 < argc) {
+            options.bootrom = argv[++i];
+        }
+        else if (arg == "--block" && i + 1 < argc) {
+            options.block = std::stoull(argv[++i]);
+        }
+        else if (arg == "--hashes" && i + 1 < argc) {
+            options.hashes = argv[++i];
+        }
+        else if (arg == "--check" && i + 1 < argc) {
+            options.check = argv[++i];
+        }
+        else {
+            std::cout << "Error: unknown option " << arg << std::endl;
+            print_usage();
+            exit(-1);
+        }
+    }
+
+    if (options.frames == 0 || options.rate <= 0 || options.block == 0) {
+        std::cout << "Error: the number of frames (--frames N), the rate and the block size must be positive." << std::endl;
+        exit(-1);
+    }
+    if (options.out == "-" && (!options.hashes.empty() || !options.check.empty())) {
+        // the report would end up in the middle of the samples
+        std::cout.rdbuf(std::cerr.rdbuf());
+    }
+    return render(rom, options);
+}
\ No newline at end of file
@@ -0,0 +1,142 @@
+/*
+bench.cpp: compare the cost of the PPU's two renderers on a ROM.
+
+Usage: gameboy-bench <rom> [--frames N] [--bootrom file] [--threads N] [--frameskip N]
+
+Runs the ROM headless for N frames (default 3600) with each renderer: the scanline renderer, the pixel FIFO engine and
+the deferred renderer (--threads workers besides the emulation thread, by default as many as the PPU picks), and prints
+the host time per frame, frames per second and the speed relative to the real Game Boy (59.73 frames per second) for
+each. The frames are taken as the emulator takes them, without waiting for the deferred renderer's threads, which draw
+a frame while the next one is emulated (so its time includes the overlap). The frames of each run are compared by hash
+with the scanline renderer's: the deferred renderer should draw the same, the pixel FIFO engine differs where the game changes the registers during mode 3, or relies on something the
+scanline renderer does not model. With --frameskip N only one frame in N + 1 is drawn (the others are only emulated, see
+PPU::set_rendering), and only the frames both runs drew are compared.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gameboy.h"
+
+struct Run {
+    double seconds = 0;
+    std::vector<uint64_t> hashes; // of every frame, by the frame_count() it was completed at
+    std::vector<bool> rendered; // the frame was drawn
+};
+
+static Run run(const std::string& bootrom, const std::string& rom, uint64_t frames, PPU::Renderer renderer, int threads, uint64_t skip)
+{
+    std::unique_ptr<GameBoy> loaded = load_or_exit(bootrom, rom, true);
+    GameBoy& gameboy = *loaded;
+    if (threads >= 0) {
+        gameboy.ppu().set_raster_threads(threads);
+    }
+    gameboy.ppu().set_renderer(renderer);
+
+    Run result;
+    result.hashes.resize(frames + 2);
+    result.rendered.resize(frames + 2);
+    auto take_frame = [&]() {
+        uint64_t number = std::min<uint64_t>(gameboy.ppu().ready_frame_number(), frames + 1);
+        result.hashes[number] = gameboy.ppu().ready_hash();
+        result.rendered[number] = true;
+    };
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t frame = 0; frame < frames; frame++) {
+        gameboy.set_rendering(frame % (skip + 1) == 0);
+        gameboy.run_frame();
+        gameboy.ppu().poll_frame();
+        take_frame();
+    }
+    gameboy.ppu().frame_hash(); // the last frame being drawn
+    take_frame();
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+static void print_run(const std::string& name, const Run& result, const Run& scanline, uint64_t frames)
+{
+    const double frame_rate = 4194304.0 / 70224; // the DMG's frames per second
+    double per_frame = result.seconds / frames;
+    std::cout << std::left << std::setw(12) << name << std::right << std::fixed
+              << std::setw(12) << std::setprecision(3) << per_frame * 1000
+              << std::setw(12) << std::setprecision(1) << 1 / per_frame
+              << std::setw(12) << std::setprecision(1) << 1 / (per_frame * frame_rate) << "x"
+              << std::setw(12) << std::setprecision(2) << result.seconds / scanline.seconds << "x";
+
+    // both runs take the same number of cycles per frame, so the same frames are compared
+    uint64_t differing = 0;
+    uint64_t first = 0;
+    for (uint64_t frame = 0; frame < result.hashes.size(); frame++) {
+        if (result.rendered[frame] && scanline.rendered[frame] && result.hashes[frame] != scanline.hashes[frame]) {
+            if (differing++ == 0) {
+                first = frame;
+            }
+        }
+    }
+    std::cout << std::setw(12) << differing;
+    if (differing) {
+        std::cout << " (the first is frame " << first << ")";
+    }
+    std::cout << std::endl;
+}
+
+static void print_usage()
+{
+    std::cout << "Usage: gameboy-bench <rom> [--frames N] [--bootrom file] [--threads N] [--frameskip N]" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2) {
+        print_usage();
+        exit(-1);
+    }
+
+    std::string rom = argv[1];
+    uint64_t frames = 3600;
+    std::string bootrom;
+    int threads = -1; // the PPU's default
+    uint64_t skip = 0;
+
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--frames" && i + 1 < argc) {
+            frames = std::stoull(argv[++i]);
+        }
+        else if (arg == "--bootrom" && i + 1 < argc) {
+            bootrom = argv[++i];
+        }
+        else if (arg == "--threads" && i + 1 < argc) {
+            threads = std::stoi(argv[++i]);
+        }
+        else if (arg == "--frameskip" && i + 1 < argc) {
+            skip = std::stoull(argv[++i]);
+        }
+        else {
+            print_usage();
+            exit(-1);
+        }
+    }
+    if (frames == 0) {
+        std::cout << "Error: the number of frames (--frames N) must be positive." << std::endl;
+        exit(-1);
+    }
+
+    Run scanline = run(bootrom, rom, frames, PPU::Renderer::Scanline, threads, skip);
+    Run fifo = run(bootrom, rom, frames, PPU::Renderer::PixelFifo, threads, skip);
+    Run deferred = run(bootrom, rom, frames, PPU::Renderer::Deferred, threads, skip);
+
+    std::cout << std::left << std::setw(12) << "renderer" << std::right << std::setw(12) << "ms/frame" << std::setw(12)
+              << "frames/s" << std::setw(13) << "real time" << std::setw(13) << "vs scanline" << std::setw(12) << "differing" << std::endl;
+    print_run("scanline", scanline, scanline, frames);
+    print_run("pixel FIFO", fifo, scanline, frames);
+    print_run("deferred", deferred, scanline, frames);
+    return 0;
+}
@@ -0,0 +1,236 @@
+/*
+golden.cpp: golden-frame regression testing.
+
+Usage:
+    gameboy-golden record <rom> <golden dir> --frames N [--movie file] [--bootrom file]
+    gameboy-golden check <rom> <golden dir> [--movie file] [--bootrom file] [--dump dir]
+    gameboy-golden check-list <list file> [--bootrom file] [--dump dir]
+
+record runs the ROM (replaying the movie, if any) headless for N frames, and stores the hash of every frame in
+<golden dir>/hashes.txt, plus one image per distinct frame in <golden dir>/frames/<hash>.pgm.
+check replays the same run and compares the hash sequence against the golden one. On the first mismatch it reports
+the frame number and writes frame_<n>_expected.pgm and frame_<n>_actual.pgm to the dump directory (default: .).
+check-list checks every "<rom> <golden dir> [movie]" line of the list file.
+
+Exits with 0 if every check passed, and 1 otherwise.
+*/
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gameboy.h"
+#include "movie.h"
+
+namespace fs = std::filesystem;
+
+struct Options {
+    std::string bootrom;
+    std::string movie;
+    uint64_t frames = 0;
+    fs::path dump_directory = ".";
+};
+
+static std::string hex(uint64_t value)
+{
+    std::stringstream stream;
+    stream << std::hex << std::setfill('0') << std::setw(16) << value;
+    return stream.str();
+}
+
+static void write_pgm(const fs::path& path, const std::array<uint8_t, SCREEN_WIDTH * SCREEN_HEIGHT>& frame)
+{
+    /* save a frame as a binary greyscale PGM image, using the same shades as the display */
+    const uint8_t shade_to_grey[] = {242, 191, 115, 0, 255};
+    std::ofstream image(path, std::ios::binary);
+    image << "P5\n" << SCREEN_WIDTH << " " << SCREEN_HEIGHT << "\n255\n";
+    for (uint8_t shade : frame) {
+        image.put(static_cast<char>(shade_to_grey[shade]));
+    }
+}
+
+class Run {
+    /* a headless run of a ROM, with the movie (if any) feeding the joypad */
+    public:
+        Run(const std::string& rom, const Options& options) : gameboy_(options.bootrom, rom, true)
+        {
+            if (!options.movie.empty()) {
+                movie_.load_movie_from_file(options.movie);
+                has_movie_ = true;
+            }
+        };
+
+        uint64_t next_frame()
+        {
+            if (has_movie_) {
+                gameboy_.set_input(movie_.input_for_frame(frame_));
+            }
+            gameboy_.run_frame();
+            frame_++;
+            return gameboy_.frame_hash();
+        };
+
+        const std::array<uint8_t, SCREEN_WIDTH * SCREEN_HEIGHT>& frame() { return gameboy_.ppu().completed_frame(); };
+
+    private:
+        GameBoy gameboy_;
+        Movie movie_;
+        bool has_movie_ = false;
+        uint64_t frame_ = 0;
+};
+
+static int record(const std::string& rom, const fs::path& golden, const Options& options)
+{
+    if (options.frames == 0) {
+        std::cout << "Error: record needs the number of frames (--frames N)." << std::endl;
+        return 1;
+    }
+
+    fs::create_directories(golden / "frames");
+    std::ofstream hashes(golden / "hashes.txt");
+    Run run(rom, options);
+
+    for (uint64_t frame = 0; frame < options.frames; frame++) {
+        uint64_t hash = run.next_frame();
+        hashes << hex(hash) << '\n';
+
+        // only distinct frames are stored, most frames of a run repeat an earlier one
+        fs::path image = golden / "frames" / (hex(hash) + ".pgm");
+        if (!fs::exists(image)) {
+            write_pgm(image, run.frame());
+        }
+    }
+
+    std::cout << "Recorded " << options.frames << " frames of " << rom << " to " << golden << std::endl;
+    return 0;
+}
+
+static int check(const std::string& rom, const fs::path& golden, const Options& options)
+{
+    std::ifstream hashes(golden / "hashes.txt");
+    if (!hashes) {
+        std::cout << "Error: could not open " << golden / "hashes.txt" << std::endl;
+        return 1;
+    }
+
+    std::vector<uint64_t> expected;
+    uint64_t hash;
+    while (hashes >> std::hex >> hash) {
+        expected.push_back(hash);
+    }
+
+    Run run(rom, options);
+    for (uint64_t frame = 0; frame < expected.size(); frame++) {
+        uint64_t actual = run.next_frame();
+        if (actual != expected[frame]) {
+            std::cout << "FAIL " << rom << ": frame " << frame << " differs (expected " << hex(expected[frame]) << ", got " << hex(actual) << ")" << std::endl;
+
+            fs::create_directories(options.dump_directory);
+            std::string prefix = "frame_" + std::to_string(frame);
+            fs::path expected_image = golden / "frames" / (hex(expected[frame]) + ".pgm");
+            if (fs::exists(expected_image)) {
+                fs::copy_file(expected_image, options.dump_directory / (prefix + "_expected.pgm"), fs::copy_options::overwrite_existing);
+            }
+            write_pgm(options.dump_directory / (prefix + "_actual.pgm"), run.frame());
+            std::cout << "     images written to " << options.dump_directory / (prefix + "_{expected,actual}.pgm") << std::endl;
+            return 1;
+        }
+    }
+
+    std::cout << "PASS " << rom << " (" << expected.size() << " frames)" << std::endl;
+    return 0;
+}
+
+static int check_list(const std::string& list_file, const Options& options)
+{
+    std::ifstream list(list_file);
+    if (!list) {
+        std::cout << "Error: could not open " << list_file << std::endl;
+        return 1;
+    }
+
+    int failures = 0;
+    std::string line;
+    while (std::getline(list, line)) {
+        std::stringstream fields(line.substr(0, line.find('#')));
+        std::string rom, golden;
+        if (!(fields >> rom >> golden)) {
+            continue;
+        }
+        Options pair_options = options;
+        fields >> pair_options.movie;
+        try {
+            failures += check(rom, golden, pair_options);
+        }
+        catch (const std::runtime_error& e) {
+            // the other ROMs of the list are still checked
+            std::cout << "ERROR " << rom << ": " << e.what() << std::endl;
+            failures++;
+        }
+    }
+    return failures == 0 ? 0 : 1;
+}
+
+static void print_usage()
+{
+    std::cout << "Usage:\n"
+              << "    gameboy-golden record <rom> <golden dir> --frames N [--movie file] [--bootrom file]\n"
+              << "    gameboy-golden check <rom> <golden dir> [--movie file] [--bootrom file] [--dump dir]\n"
+              << "    gameboy-golden check-list <list file> [--bootrom file] [--dump dir]" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3) {
+        print_usage();
+        exit(-1);
+    }
+
+    std::string mode = argv[1];
+    std::vector<std::string> positional;
+    Options options;
+
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--frames" && i + 1 < argc) {
+            options.frames = std::stoull(argv[++i]);
+        }
+        else if (arg == "--movie" && i + 1 < argc) {
+            options.movie = argv[++i];
+        }
+        else if (arg == "--bootrom" && i + 1 < argc) {
+            options.bootrom = argv[++i];
+        }
+        else if (arg == "--dump" && i + 1 < argc) {
+            options.dump_directory = argv[++i];
+        }
+        else {
+            positional.push_back(arg);
+        }
+    }
+
+    try {
+        if (mode == "record" && positional.size() == 2) {
+            return record(positional[0], positional[1], options);
+        }
+        else if (mode == "check" && positional.size() == 2) {
+            return check(positional[0], positional[1], options);
+        }
+        else if (mode == "check-list" && positional.size() == 1) {
+            return check_list(positional[0], options);
+        }
+    }
+    catch (const std::runtime_error& e) {
+        std::cout << "Error: " << e.what() << std::endl;
+        return -1;
+    }
+
+    print_usage();
+    return -1;
+}
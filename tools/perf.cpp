@@ -0,0 +1,58 @@
+/*
+perf.cpp: read the hardware performance counters (Linux perf_event_open) of a headless run.
+
+Usage: gameboy-perf <rom> [--frames N] [--bootrom file]
+
+Runs the ROM headless for N frames (default 3600) and prints cycles, instructions, branch misses and L1-I / L1-D / LLC
+misses for the whole emulation loop, the CPU (sampled) and the scanline renders, with IPC and the counts per emulated
+instruction. Run it before and after an optimization on the same ROM to compare.
+*/
+
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "gameboy.h"
+
+static void print_usage()
+{
+    std::cout << "Usage: gameboy-perf <rom> [--frames N] [--bootrom file]" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2) {
+        print_usage();
+        exit(-1);
+    }
+
+    std::string rom = argv[1];
+    uint64_t frames = 3600;
+    std::string bootrom;
+
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--frames" && i + 1 < argc) {
+            frames = std::stoull(argv[++i]);
+        }
+        else if (arg == "--bootrom" && i + 1 < argc) {
+            bootrom = argv[++i];
+        }
+        else {
+            print_usage();
+            exit(-1);
+        }
+    }
+
+    std::unique_ptr<GameBoy> loaded = load_or_exit(bootrom, rom, true);
+    GameBoy& gameboy = *loaded;
+    PerfCounters& perf_counters = gameboy.start_perf_counters();
+    for (uint64_t frame = 0; frame < frames; frame++) {
+        gameboy.run_frame();
+    }
+
+    perf_counters.write_report(std::cout);
+    gameboy.instrumentation().write_report(std::cout);
+    return 0;
+}
\ No newline at end of file
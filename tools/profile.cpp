@@ -0,0 +1,108 @@
+/*
+profile.cpp: profile where a game spends its emulated cycles (emulator built with -DGAMEBOY_PROFILE=ON).
+
+Usage: gameboy-profile <rom> [--frames N] [--exact] [--period cycles] [--sym file] [--folded file] [--top N]
+                       [--movie file] [--bootrom file]
+
+Runs the ROM headless for N frames (default 3600, one minute), replaying the movie if one is given, and prints the
+functions and instructions that took the most cycles (top 20 by default). The cycles are sampled every --period
+cycles on average (default 1000) unless --exact is given. Symbols are read from --sym, or from the .sym file next
+to the ROM if there is one. --folded writes the call stacks in the folded format of flamegraph.pl.
+*/
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "gameboy.h"
+#include "movie.h"
+
+namespace fs = std::filesystem;
+
+static void print_usage()
+{
+    std::cout << "Usage: gameboy-profile <rom> [--frames N] [--exact] [--period cycles] [--sym file] [--folded file] [--top N]\n"
+              << "                       [--movie file] [--bootrom file]" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2) {
+        print_usage();
+        exit(-1);
+    }
+
+    std::string rom = argv[1];
+    uint64_t frames = 3600;
+    bool exact = false;
+    uint32_t period = 1000;
+    std::string sym_file, folded_file, movie_file, bootrom;
+    size_t top = 20;
+
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--frames" && i + 1 < argc) {
+            frames = std::stoull(argv[++i]);
+        }
+        else if (arg == "--exact") {
+            exact = true;
+        }
+        else if (arg == "--period" && i + 1 < argc) {
+            period = std::stoul(argv[++i]);
+        }
+        else if (arg == "--sym" && i + 1 < argc) {
+            sym_file = argv[++i];
+        }
+        else if (arg == "--folded" && i + 1 < argc) {
+            folded_file = argv[++i];
+        }
+        else if (arg == "--top" && i + 1 < argc) {
+            top = std::stoul(argv[++i]);
+        }
+        else if (arg == "--movie" && i + 1 < argc) {
+            movie_file = argv[++i];
+        }
+        else if (arg == "--bootrom" && i + 1 < argc) {
+            bootrom = argv[++i];
+        }
+        else {
+            print_usage();
+            exit(-1);
+        }
+    }
+
+    // RGBDS writes the symbols next to the ROM by default
+    if (sym_file.empty() && fs::exists(fs::path(rom).replace_extension(".sym"))) {
+        sym_file = fs::path(rom).replace_extension(".sym").string();
+    }
+
+    std::unique_ptr<GameBoy> loaded = load_or_exit(bootrom, rom, true);
+    GameBoy& gameboy = *loaded;
+    Profiler& profiler = gameboy.start_profile(exact, period);
+    if (!sym_file.empty()) {
+        load_or_exit([&]() { profiler.load_symbols(sym_file); });
+    }
+
+    Movie movie;
+    if (!movie_file.empty()) {
+        load_or_exit([&]() { movie.load_movie_from_file(movie_file); });
+    }
+
+    for (uint64_t frame = 0; frame < frames; frame++) {
+        if (!movie_file.empty()) {
+            gameboy.set_input(movie.input_for_frame(frame));
+        }
+        gameboy.run_frame();
+    }
+
+    profiler.write_report(std::cout, top);
+    if (!folded_file.empty()) {
+        std::ofstream folded(folded_file);
+        profiler.write_folded(folded);
+        std::cout << "Folded stacks written to " << folded_file << std::endl;
+    }
+    return 0;
+}
\ No newline at end of file
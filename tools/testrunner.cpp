@@ -0,0 +1,230 @@
+/*
+testrunner.cpp: run a directory of test ROMs headless and in parallel, and detect whether each one passed.
+
+Usage: gameboy-testrunner <rom directory> [--jobs N] [--timeout seconds] [--bootrom file]
+
+A test ROM's result is taken from (in order):
+    1) the serial output: blargg ROMs (cpu_instrs, instr_timing, mem_timing) print "Passed" or "Failed"
+    2) the mooneye signature: LD B,B is executed with B,C,D,E,H,L = 3,5,8,13,21,34 on success
+    3) the final frame: if <rom>.hash exists next to the ROM, the hash of the last frame (after the timeout)
+       is compared against the hex value stored in it
+
+A ROM with none of the above before its timeout (in emulated seconds) is reported as a timeout, which counts as a failure.
+Exits with 0 if every ROM passed, and 1 otherwise.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gameboy.h"
+
+namespace fs = std::filesystem;
+
+enum class Verdict { Pass, Fail, Timeout, Error };
+
+struct Result {
+    Verdict verdict = Verdict::Timeout;
+    std::string method; // how the verdict was detected
+    double emulated_seconds = 0;
+    std::string detail; // serial output / registers / hashes, printed for failures
+};
+
+static const double frames_per_second = 4194304.0 / 70224.0;
+
+static std::string hex(uint64_t value, int width)
+{
+    std::stringstream stream;
+    stream << std::hex << std::setfill('0') << std::setw(width) << value;
+    return stream.str();
+}
+
+static Result check_mooneye(CPU::Registers registers)
+{
+    /* mooneye test ROMs load the fibonacci numbers 3, 5, 8, 13, 21, 34 into B, C, D, E, H, L before executing LD B,B on success */
+    Result result;
+    result.method = "mooneye";
+    if (registers.bc == 0x0305 && registers.de == 0x080d && registers.hl == 0x1522) {
+        result.verdict = Verdict::Pass;
+    }
+    else {
+        result.verdict = Verdict::Fail;
+        result.detail = "BC=" + hex(registers.bc, 4) + " DE=" + hex(registers.de, 4) + " HL=" + hex(registers.hl, 4);
+    }
+    return result;
+}
+
+static Result run_rom(const fs::path& rom, const std::string& bootrom, double timeout_seconds)
+{
+    /* run a single test ROM until it reports a result or the timeout (in emulated seconds) is reached */
+    GameBoy gameboy{bootrom, rom.string(), true};
+    Result result;
+
+    const int max_frames = static_cast<int>(timeout_seconds * frames_per_second);
+    size_t serial_scanned = 0; // only search the newly transferred characters
+
+    for (int frame = 1; frame <= max_frames; frame++) {
+        gameboy.run_frame();
+        result.emulated_seconds = frame / frames_per_second;
+
+        // blargg: look for the result line on the serial port
+        const std::string& output = gameboy.serial().output();
+        if (output.size() > serial_scanned) {
+            // a match can straddle two frames, so search again from a few characters back
+            size_t from = serial_scanned >= 6 ? serial_scanned - 6 : 0;
+            serial_scanned = output.size();
+            if (output.find("Passed", from) != std::string::npos) {
+                result.verdict = Verdict::Pass;
+                result.method = "serial";
+                return result;
+            }
+            if (output.find("Failed", from) != std::string::npos) {
+                // let the ROM finish printing which tests failed
+                for (int extra = 0; extra < 30; extra++) {
+                    gameboy.run_frame();
+                }
+                result.verdict = Verdict::Fail;
+                result.method = "serial";
+                result.detail = gameboy.serial().output();
+                return result;
+            }
+        }
+
+        // mooneye: LD B,B marks the end of the test
+        if (gameboy.cpu().breakpoint_hit()) {
+            Result mooneye = check_mooneye(gameboy.cpu().get_registers());
+            mooneye.emulated_seconds = result.emulated_seconds;
+            return mooneye;
+        }
+    }
+
+    // the ROM did not report anything, compare the final frame against the expected hash if there is one
+    fs::path hash_file = rom;
+    hash_file.replace_extension(".hash");
+    std::ifstream hash_reader(hash_file);
+    uint64_t expected;
+    if (hash_reader >> std::hex >> expected) {
+        uint64_t actual = gameboy.frame_hash();
+        result.method = "frame hash";
+        if (actual == expected) {
+            result.verdict = Verdict::Pass;
+        }
+        else {
+            result.verdict = Verdict::Fail;
+            result.detail = "expected " + hex(expected, 16) + ", got " + hex(actual, 16);
+        }
+        return result;
+    }
+
+    result.verdict = Verdict::Timeout;
+    result.detail = gameboy.serial().output();
+    return result;
+}
+
+static void print_usage()
+{
+    std::cout << "Usage: gameboy-testrunner <rom directory> [--jobs N] [--timeout seconds] [--bootrom file]" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2) {
+        print_usage();
+        exit(-1);
+    }
+
+    fs::path rom_directory = argv[1];
+    unsigned int jobs = std::max(1u, std::thread::hardware_concurrency());
+    double timeout_seconds = 60.0;
+    std::string bootrom;
+
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--jobs" && i + 1 < argc) {
+            jobs = std::max(1, std::stoi(argv[++i]));
+        }
+        else if (arg == "--timeout" && i + 1 < argc) {
+            timeout_seconds = std::stod(argv[++i]);
+        }
+        else if (arg == "--bootrom" && i + 1 < argc) {
+            bootrom = argv[++i];
+        }
+        else {
+            print_usage();
+            exit(-1);
+        }
+    }
+
+    // collect every ROM in the directory (and its subdirectories)
+    std::vector<fs::path> roms;
+    for (const auto& entry : fs::recursive_directory_iterator(rom_directory)) {
+        if (entry.is_regular_file() && (entry.path().extension() == ".gb" || entry.path().extension() == ".gbc")) {
+            roms.push_back(entry.path());
+        }
+    }
+    std::sort(roms.begin(), roms.end());
+
+    if (roms.empty()) {
+        std::cout << "Error: no .gb files found in " << rom_directory << std::endl;
+        exit(-1);
+    }
+
+    // each worker takes the next ROM that has not been started yet, results are printed as they come in
+    std::vector<Result> results(roms.size());
+    std::atomic<size_t> next_rom = 0;
+    std::mutex print_mutex;
+
+    auto worker = [&]() {
+        size_t index;
+        while ((index = next_rom++) < roms.size()) {
+            Result result;
+            try {
+                result = run_rom(roms[index], bootrom, timeout_seconds);
+            }
+            catch (const std::exception& e) {
+                result.verdict = Verdict::Error;
+                result.detail = e.what();
+            }
+
+            std::lock_guard<std::mutex> lock(print_mutex);
+            const char* label[] = {"PASS", "FAIL", "TIMEOUT", "ERROR"};
+            std::cout << std::left << std::setw(8) << label[static_cast<int>(result.verdict)] << fs::relative(roms[index], rom_directory).string();
+            if (!result.method.empty()) {
+                std::cout << " (" << result.method << ", " << std::fixed << std::setprecision(1) << result.emulated_seconds << "s)";
+            }
+            std::cout << '\n';
+            if (result.verdict != Verdict::Pass && !result.detail.empty()) {
+                // indent the (possibly multi-line) detail under the result line
+                std::stringstream detail(result.detail);
+                std::string line;
+                while (std::getline(detail, line)) {
+                    std::cout << "        " << line << '\n';
+                }
+            }
+            results[index] = result;
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned int i = 0; i < std::min<size_t>(jobs, roms.size()); i++) {
+        workers.emplace_back(worker);
+    }
+    for (auto& thread : workers) {
+        thread.join();
+    }
+
+    size_t passed = std::count_if(results.begin(), results.end(), [](const Result& result) { return result.verdict == Verdict::Pass; });
+    std::cout << "\n" << passed << " / " << results.size() << " test ROMs passed" << std::endl;
+
+    return passed == results.size() ? 0 : 1;
+}
@@ -0,0 +1,116 @@
+/*
+trace.cpp: inspect the binary CPU traces written with --trace (emulator built with -DGAMEBOY_TRACE=ON).
+
+Usage:
+    gameboy-trace info <trace file>
+    gameboy-trace text <trace file> [--from-cycle N] [--count M]
+    gameboy-trace seek <trace file> <cycle>
+
+info prints the number of records and the cycle range of the trace.
+text converts the records to the gameboy-doctor log format ("A:01 F:B0 B:00 ... PCMEM:00,C3,13,02"), one line per
+instruction, starting at the first instruction fetched at or after cycle N (default: the start of the trace).
+seek prints the record number and log line of the first instruction fetched at or after the given cycle.
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "trace_file.h"
+
+static void print_usage()
+{
+    std::cout << "Usage:\n"
+              << "    gameboy-trace info <trace file>\n"
+              << "    gameboy-trace text <trace file> [--from-cycle N] [--count M]\n"
+              << "    gameboy-trace seek <trace file> <cycle>" << std::endl;
+}
+
+static int info(const TraceFile& trace)
+{
+    std::cout << trace.size() << " instructions";
+    if (trace.size() > 0) {
+        std::cout << ", cycles " << trace[0].cycle << " - " << trace[trace.size() - 1].cycle;
+    }
+    std::cout << std::endl;
+    return 0;
+}
+
+static int text(const TraceFile& trace, uint64_t from_cycle, uint64_t count)
+{
+    // format into a large buffer and write it with stdio, converting a long trace is bound by the output otherwise
+    std::vector<char> buffer(1 << 20);
+    size_t used = 0;
+
+    uint64_t end = trace.size();
+    uint64_t first = trace.find_cycle(from_cycle);
+    if (count < end - first) {
+        end = first + count;
+    }
+
+    for (uint64_t record = first; record < end; record++) {
+        if (buffer.size() - used < format_doctor_line_length + 1) {
+            fwrite(buffer.data(), 1, used, stdout);
+            used = 0;
+        }
+        used += format_doctor_line(trace[record], buffer.data() + used);
+        buffer[used++] = '\n';
+    }
+    fwrite(buffer.data(), 1, used, stdout);
+    return 0;
+}
+
+static int seek(const TraceFile& trace, uint64_t cycle)
+{
+    uint64_t record = trace.find_cycle(cycle);
+    if (record == trace.size()) {
+        std::cout << "No instruction at or after cycle " << cycle << std::endl;
+        return 1;
+    }
+
+    char line[format_doctor_line_length];
+    size_t length = format_doctor_line(trace[record], line);
+    std::cout << "record " << record << " (cycle " << trace[record].cycle << "): " << std::string(line, length) << std::endl;
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3) {
+        print_usage();
+        exit(-1);
+    }
+
+    std::string mode = argv[1];
+    std::vector<std::string> positional;
+    uint64_t from_cycle = 0;
+    uint64_t count = UINT64_MAX;
+
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--from-cycle" && i + 1 < argc) {
+            from_cycle = std::stoull(argv[++i]);
+        }
+        else if (arg == "--count" && i + 1 < argc) {
+            count = std::stoull(argv[++i]);
+        }
+        else {
+            positional.push_back(arg);
+        }
+    }
+
+    if (mode == "info" && positional.size() == 1) {
+        return info(TraceFile(positional[0]));
+    }
+    else if (mode == "text" && positional.size() == 1) {
+        return text(TraceFile(positional[0]), from_cycle, count);
+    }
+    else if (mode == "seek" && positional.size() == 2) {
+        return seek(TraceFile(positional[0]), std::stoull(positional[1]));
+    }
+
+    print_usage();
+    return -1;
+}
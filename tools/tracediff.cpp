@@ -0,0 +1,301 @@
+/*
+tracediff.cpp: find the first instruction where a binary CPU trace diverges from a reference emulator's log.
+
+Usage: gameboy-tracediff <trace file> <reference log> [--jobs N] [--context N] [--skip N]
+
+The reference log is a gameboy-doctor format text log ("A:01 F:B0 B:00 C:13 ... PC:0100 PCMEM:00,C3,13,02", one line
+per instruction), as written by most other emulators. Line n of the log is compared against record n of the trace
+(after skipping the first --skip records, e.g. the boot ROM when the reference starts at 0x100).
+Hex digits are compared case insensitively, and CRLF line endings are accepted.
+
+Both files are memory mapped and the log is split into one chunk per job, compared in parallel: the first pass counts
+the lines in each chunk (so every chunk knows its first line number), the second compares them. A chunk stops as soon
+as it is past a divergence already found by an earlier chunk.
+
+On a divergence, the preceding --context lines (default 5), both versions of the divergent line and the registers
+that differ are printed. Exits with 0 if the traces match, and 1 otherwise.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "trace_file.h"
+
+class ReferenceLog {
+    /* a memory mapped text log */
+    public:
+        ReferenceLog(const std::string& log_file)
+        {
+            int fd = open(log_file.c_str(), O_RDONLY);
+            struct stat file_stat;
+            if (fd < 0 || fstat(fd, &file_stat) != 0) {
+                std::cout << "Error: could not open the reference log " << log_file << std::endl;
+                exit(-1);
+            }
+            size_ = file_stat.st_size;
+            if (size_ > 0) {
+                data_ = static_cast<const char*>(mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0));
+                if (data_ == MAP_FAILED) {
+                    std::cout << "Error: could not map the reference log " << log_file << std::endl;
+                    exit(-1);
+                }
+                madvise(const_cast<char*>(data_), size_, MADV_SEQUENTIAL);
+            }
+            close(fd);
+        };
+        ~ReferenceLog() { if (size_ > 0) { munmap(const_cast<char*>(data_), size_); } };
+
+        const char* begin() const { return data_; };
+        const char* end() const { return data_ + size_; };
+        size_t size() const { return size_; };
+
+    private:
+        const char* data_ = nullptr;
+        size_t size_ = 0;
+};
+
+struct Chunk {
+    const char* begin; // first byte of the first line in the chunk
+    const char* end; // one past the newline ending the last line
+    uint64_t first_line = 0;
+    uint64_t lines = 0;
+    uint64_t divergence = UINT64_MAX; // first line of the chunk that differs, if any
+    const char* divergent_line = nullptr;
+};
+
+static std::string_view trim_line(const char* begin, const char* end)
+{
+    // drop the line ending (LF or CRLF) and trailing spaces
+    while (end > begin && (end[-1] == '\n' || end[-1] == '\r' || end[-1] == ' ')) {
+        end--;
+    }
+    return std::string_view(begin, end - begin);
+}
+
+static bool lines_match(std::string_view ours, std::string_view reference)
+{
+    // fast path: the reference uses the same upper case format as we do
+    if (ours.size() != reference.size()) {
+        return false;
+    }
+    if (std::memcmp(ours.data(), reference.data(), ours.size()) == 0) {
+        return true;
+    }
+    for (size_t i = 0; i < ours.size(); i++) {
+        if (ours[i] != std::toupper(static_cast<unsigned char>(reference[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void print_register_diff(std::string_view ours, std::string_view reference)
+{
+    /* compare the "NAME:value" fields of both lines, and print the ones that differ */
+    auto fields = [](std::string_view line) {
+        std::vector<std::pair<std::string, std::string>> result;
+        size_t start = 0;
+        while (start < line.size()) {
+            size_t end = line.find(' ', start);
+            if (end == std::string_view::npos) {
+                end = line.size();
+            }
+            std::string_view field = line.substr(start, end - start);
+            size_t colon = field.find(':');
+            if (colon != std::string_view::npos) {
+                std::string value(field.substr(colon + 1));
+                std::transform(value.begin(), value.end(), value.begin(), [](unsigned char c) { return std::toupper(c); });
+                result.push_back({std::string(field.substr(0, colon)), value});
+            }
+            start = end + 1;
+        }
+        return result;
+    };
+
+    auto our_fields = fields(ours);
+    auto reference_fields = fields(reference);
+    for (const auto& [name, value] : reference_fields) {
+        auto match = std::find_if(our_fields.begin(), our_fields.end(), [&](const auto& field) { return field.first == name; });
+        if (match == our_fields.end()) {
+            std::cout << "    " << name << ": missing from our trace (reference " << value << ")\n";
+        }
+        else if (match->second != value) {
+            std::cout << "    " << name << ": ours " << match->second << ", reference " << value << "\n";
+        }
+    }
+}
+
+static void print_usage()
+{
+    std::cout << "Usage: gameboy-tracediff <trace file> <reference log> [--jobs N] [--context N] [--skip N]" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3) {
+        print_usage();
+        exit(-1);
+    }
+
+    unsigned int jobs = std::max(1u, std::thread::hardware_concurrency());
+    uint64_t context = 5;
+    uint64_t skip = 0;
+    for (int i = 3; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--jobs" && i + 1 < argc) {
+            jobs = std::max(1, std::stoi(argv[++i]));
+        }
+        else if (arg == "--context" && i + 1 < argc) {
+            context = std::stoull(argv[++i]);
+        }
+        else if (arg == "--skip" && i + 1 < argc) {
+            skip = std::stoull(argv[++i]);
+        }
+        else {
+            print_usage();
+            exit(-1);
+        }
+    }
+
+    TraceFile trace(argv[1]);
+    ReferenceLog reference(argv[2]);
+    uint64_t records = trace.size() > skip ? trace.size() - skip : 0;
+
+    // split the log into chunks of about the same size, each ending at a line boundary
+    std::vector<Chunk> chunks;
+    const char* chunk_begin = reference.begin();
+    for (unsigned int i = 1; i <= jobs && chunk_begin < reference.end(); i++) {
+        const char* chunk_end = reference.end();
+        if (i < jobs) {
+            chunk_end = std::max(chunk_begin, reference.begin() + reference.size() / jobs * i);
+            const char* newline = static_cast<const char*>(std::memchr(chunk_end, '\n', reference.end() - chunk_end));
+            chunk_end = newline ? newline + 1 : reference.end();
+        }
+        chunks.push_back({chunk_begin, chunk_end});
+        chunk_begin = chunk_end;
+    }
+
+    auto run_parallel = [&](auto work) {
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < chunks.size(); i++) {
+            workers.emplace_back(work, std::ref(chunks[i]));
+        }
+        for (auto& thread : workers) {
+            thread.join();
+        }
+    };
+
+    // pass 1: count the lines of every chunk, to know the line number each one starts at
+    run_parallel([](Chunk& chunk) {
+        chunk.lines = std::count(chunk.begin, chunk.end, '\n');
+        if (chunk.end > chunk.begin && chunk.end[-1] != '\n') {
+            chunk.lines++; // the last line of the log has no newline
+        }
+    });
+    uint64_t reference_lines = 0;
+    for (Chunk& chunk : chunks) {
+        chunk.first_line = reference_lines;
+        reference_lines += chunk.lines;
+    }
+
+    // pass 2: compare every chunk against the records with the same line numbers
+    // each chunk keeps its own first divergence; the shared one only lets the chunks after it stop early
+    std::atomic<uint64_t> divergence = std::min(records, reference_lines); // first line that differs (or the end of the shorter one)
+    run_parallel([&](Chunk& chunk) {
+        char ours[format_doctor_line_length];
+        const char* line = chunk.begin;
+        for (uint64_t n = chunk.first_line; line < chunk.end; n++) {
+            if (n >= divergence.load(std::memory_order_relaxed)) {
+                return; // an earlier divergence was already found
+            }
+            const char* newline = static_cast<const char*>(std::memchr(line, '\n', chunk.end - line));
+            const char* line_end = newline ? newline + 1 : chunk.end;
+
+            size_t length = format_doctor_line(trace[skip + n], ours);
+            if (!lines_match(std::string_view(ours, length), trim_line(line, line_end))) {
+                chunk.divergence = n;
+                chunk.divergent_line = line;
+                uint64_t current = divergence.load();
+                while (n < current && !divergence.compare_exchange_weak(current, n)) {}
+                return;
+            }
+            line = line_end;
+        }
+    });
+
+    // the earliest divergence of all chunks
+    uint64_t first = std::min(records, reference_lines);
+    const char* divergent_line = nullptr;
+    for (const Chunk& chunk : chunks) {
+        if (chunk.divergence < first) {
+            first = chunk.divergence;
+            divergent_line = chunk.divergent_line;
+        }
+    }
+    if (first == records && first == reference_lines) {
+        std::cout << "Traces match (" << records << " instructions)" << std::endl;
+        return 0;
+    }
+
+    // find the start of the context lines by walking back from the divergent line
+    const char* line = divergent_line;
+    if (!line) {
+        // one trace ended before the other: the divergence is just past the end of the shorter one
+        line = reference.begin();
+        for (uint64_t n = 0; n < first && line < reference.end(); n++) {
+            const char* newline = static_cast<const char*>(std::memchr(line, '\n', reference.end() - line));
+            line = newline ? newline + 1 : reference.end();
+        }
+    }
+    const char* context_begin = line;
+    uint64_t context_lines = 0;
+    while (context_lines < std::min(context, first) && context_begin > reference.begin()) {
+        context_begin--;
+        while (context_begin > reference.begin() && context_begin[-1] != '\n') {
+            context_begin--;
+        }
+        context_lines++;
+    }
+
+    std::cout << "Traces diverge at instruction " << first << " (line " << first + 1 << " of the reference log";
+    if (first < records) {
+        std::cout << ", cycle " << trace[skip + first].cycle;
+    }
+    std::cout << ")\n\n";
+
+    for (const char* context_line = context_begin; context_line < line;) {
+        const char* newline = static_cast<const char*>(std::memchr(context_line, '\n', line - context_line));
+        const char* context_end = newline ? newline + 1 : line;
+        std::cout << "            " << trim_line(context_line, context_end) << "\n";
+        context_line = context_end;
+    }
+
+    char ours[format_doctor_line_length];
+    std::string_view our_line = first < records ? std::string_view(ours, format_doctor_line(trace[skip + first], ours)) : "(end of trace)";
+    std::string_view reference_line = "(end of log)";
+    if (first < reference_lines) {
+        const char* newline = static_cast<const char*>(std::memchr(line, '\n', reference.end() - line));
+        reference_line = trim_line(line, newline ? newline + 1 : reference.end());
+    }
+    std::cout << "ours:       " << our_line << "\n";
+    std::cout << "reference:  " << reference_line << "\n";
+
+    if (first < records && first < reference_lines) {
+        std::cout << "\n";
+        print_register_diff(our_line, reference_line);
+    }
+    std::cout << std::flush;
+    return 1;
+}
\ No newline at end of file